@@ -0,0 +1,120 @@
+#include "../source/lexer/lexer.hpp"
+#include "../source/lexer/char_scanner.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Lexer throughput, once per scanner implementation available on this CPU:
+//   runs  - the raw scanners over long whitespace, identifier and string runs
+//   lexer - Lexer::tokenize over a large generated program
+//
+// The vector scanners only pay off on long runs. On typical token lengths
+// whole-lexer throughput is bound by per-token work (keyword lookup,
+// interning, storing the token), and SSE2 and AVX2 come out within noise
+// of the scalar scanner: about 0.3-0.4 GB/s for all three, against 2, 6.5
+// and 8 GB/s on the runs.
+//
+// Usage: ./dust-lang-lexer-benchmark [size in MiB, default 256]
+
+static const char* const SCANNER_NAMES[] = { "scalar", "sse2", "avx2" };
+
+static std::string generate_source(size_t target_size)
+{
+    const std::string statements[] = {
+        "mut someRatherLongVariableName = (12345 * 678) + 3.14159265;\n",
+        "const anotherConstantIdentifier = ? someRatherLongVariableName == 42;\n",
+        "writeln(\"a string literal that is long enough to span several vector widths, as generated programs that embed text data tend to have\");\n",
+        "                                \t\t\t\t        mut indented = someRatherLongVariableName / 7;\n",
+    };
+
+    std::string source = "use io;\n";
+    source.reserve(target_size + 256);
+
+    for (size_t i = 0; source.size() < target_size; ++i)
+    {
+        source += statements[i % std::size(statements)];
+    }
+
+    return source;
+}
+
+template <typename Function>
+static double best_of_three(Function function)
+{
+    double best_seconds = 1e30;
+
+    for (int run = 0; run < 3; ++run)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        best_seconds = std::min(best_seconds, elapsed.count());
+    }
+
+    return best_seconds;
+}
+
+static void print_throughput(const char* name, size_t bytes, double seconds)
+{
+    std::cout << std::setw(8) << name << ": " << std::fixed << std::setprecision(3) << (bytes / seconds) / 1e9 << " GB/s" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    size_t size = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256) << 20;
+
+    std::string spaces(size, ' ');
+    std::string letters(size, 'a');
+
+    std::cout << "runs (" << (size >> 20) << " MiB each of whitespace, identifier and string bytes)" << std::endl;
+
+    for (const char* name : SCANNER_NAMES)
+    {
+        const CharScanner* scanner = find_char_scanner(name);
+
+        if (scanner == nullptr)
+        {
+            std::cout << std::setw(8) << name << ": not supported on this CPU" << std::endl;
+            continue;
+        }
+
+        volatile size_t sink = 0;
+        double seconds = best_of_three([&]
+        {
+            sink = scanner->skip_whitespace(spaces.data(), spaces.size(), 0)
+                 + scanner->identifier_end(letters.data(), letters.size(), 0)
+                 + scanner->find_quote(letters.data(), letters.size(), 0);
+        });
+
+        print_throughput(name, 3 * size, seconds);
+    }
+
+    std::string source = generate_source(size);
+
+    std::cout << "lexer (" << (source.size() >> 20) << " MiB generated program)" << std::endl;
+
+    for (const char* name : SCANNER_NAMES)
+    {
+        const CharScanner* scanner = find_char_scanner(name);
+
+        if (scanner == nullptr)
+        {
+            continue;
+        }
+
+        double seconds = best_of_three([&]
+        {
+            Lexer lexer(source, *scanner);
+            TokenStream tokens = lexer.tokenize();
+        });
+
+        print_throughput(name, source.size(), seconds);
+    }
+
+    return 0;
+}
@@ -1,37 +1,57 @@
-#include "source/token/token.hpp"
-#include "source/lexer/lexer.hpp"
 #include "source/compiler/llvm_compiler.hpp"
 #include "source/compiler/llvm_executable_builder.hpp"
-#include "source/token/token_buffer/token_buffer.hpp"
+#include "source/compiler/llvm_jit_runner.hpp"
+#include "source/compiler/llvm_target.hpp"
+#include "source/driver/build_cache.hpp"
+#include "source/driver/command_line.hpp"
+#include "source/driver/program_builder.hpp"
+#include "source/source_file/source_file.hpp"
+
+#include <optional>
 
 int main(int argc, char** argv) 
 {
-    if(argc != 2)
-    {
-        std::cerr << "[-] Incorrect usage." << std::endl;
-        std::cerr << "[-] Correct usage: ./dust-lang [input.dust]" << std::endl;
+    CommandLineOptions options = parse_command_line(argc, argv);
 
-        exit(EXIT_FAILURE);
-    }
+    // --run executes on this machine, so without --mcpu the optimizer should
+    // see the host CPU the JIT generates code for, not generic x86-64.
+    TargetCpu cpu = resolve_target_cpu(options.run && options.cpu.empty() ? "native" : options.cpu);
+    std::unique_ptr<llvm::TargetMachine> target_machine = create_target_machine(options.optimization_level, cpu, options.fast_math);
 
-    std::string source;
-    {
-        std::fstream file_input(argv[1], std::ios::in);
-        std::stringstream stream_input;
+    // Running always compiles; only executables are cached.
+    std::optional<BuildCache> cache;
+    std::string cache_key;
 
-        stream_input << file_input.rdbuf();
-        source = stream_input.str();
+    if(options.use_cache && !options.run)
+    {
+        cache.emplace(options.cache_dir.empty() ? BuildCache::get_default_directory() : std::filesystem::path(options.cache_dir), options.cache_size_limit);
+        SourceFile source(options.input_file);
+        cache_key = BuildCache::make_key(source.get_source(), options, *target_machine);
+
+        if(cache->restore(cache_key, options.input_file, options.output_file))
+        {
+            return 0;
+        }
     }
 
-    Lexer lexer(std::move(source));
-    std::vector<Token> tokens = lexer.tokenize();
+    ProgramBuilder builder(options.optimization_level, cpu, options.fast_math);
+    std::unique_ptr<LLVMCompiler> compiler = builder.build(options.input_file);
+    compiler->verify_module();
+    compiler->optimize(options.optimization_level, *target_machine);
 
-    LLVMCompiler compiler("dust_prog", std::move(TokenBuffer(std::move(tokens))));
-    compiler.generate();
-    compiler.verify_module();
+    if(options.run)
+    {
+        LLVMJitRunner runner(compiler->release_module(), options.optimization_level, cpu, options.fast_math);
+        return static_cast<int>(runner.run());
+    }
 
-    LLVMExecutableBuilder exec(compiler.get_llvm_ir_as_string(), "out");
+    LLVMExecutableBuilder exec(compiler->get_module(), *target_machine, options.output_file, options.linker);
     exec.build_executable();
 
+    if(cache)
+    {
+        cache->store(cache_key, options.input_file, builder.get_module_paths(), options.output_file);
+    }
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,14 @@
+#include "arena.hpp"
+
+#include <algorithm>
+
+void* Arena::allocate_slow(size_t size, size_t alignment)
+{
+    size_t block_size = std::max(BLOCK_SIZE, size + alignment);
+
+    m_blocks.emplace_back(new std::byte[block_size]);
+    m_cursor = m_blocks.back().get();
+    m_end = m_cursor + block_size;
+
+    return allocate(size, alignment);
+}
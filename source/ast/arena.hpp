@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Bump allocator for AST nodes. Nodes are carved out of large blocks and
+// are never destroyed individually: the whole tree is released at once
+// when the arena goes away, so node types must be trivially destructible.
+class Arena
+{
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    std::vector<std::unique_ptr<std::byte[]>> m_blocks;
+    std::byte* m_cursor = nullptr;
+    std::byte* m_end = nullptr;
+    size_t m_bytes_allocated = 0;
+
+    void* allocate_slow(size_t size, size_t alignment);
+
+public:
+    Arena() = default;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    inline void* allocate(size_t size, size_t alignment)
+    {
+        uintptr_t address = reinterpret_cast<uintptr_t>(m_cursor);
+        uintptr_t aligned = (address + alignment - 1) & ~(uintptr_t(alignment) - 1);
+
+        if (m_cursor == nullptr || aligned + size > reinterpret_cast<uintptr_t>(m_end))
+        {
+            return allocate_slow(size, alignment);
+        }
+
+        m_cursor = reinterpret_cast<std::byte*>(aligned + size);
+        m_bytes_allocated += size;
+
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena nodes are never destroyed.");
+
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Copies count items, e.g. the arguments of a call, into the arena.
+    template <typename T>
+    T* make_array(const T* items, size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "Arena arrays are copied bytewise.");
+
+        if (count == 0)
+        {
+            return nullptr;
+        }
+
+        T* array = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        std::memcpy(array, items, sizeof(T) * count);
+
+        return array;
+    }
+
+    inline size_t get_bytes_allocated() const { return m_bytes_allocated; }
+};
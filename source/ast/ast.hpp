@@ -0,0 +1,329 @@
+#pragma once
+
+#include "../token/token_type.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// AST produced by the Parser and lowered by LLVMCompiler. Every node lives
+// in an Arena and refers to names and string literals through views into
+// the source, so nodes are trivially destructible and freed in one shot.
+// Identifiers also carry the symbol ID the lexer interned them under.
+
+enum class ExpressionKind
+{
+    INTEGER,
+    FLOAT,
+    STRING,
+    BOOL,
+    VARIABLE,
+    BINARY,
+    COMPARE,
+    CALL,
+    ARRAY,
+    ARRAY_FILL,
+    INDEX
+};
+
+// Spelled type of a function parameter or result.
+enum class TypeAnnotation
+{
+    NONE,
+    INT,
+    FLOAT,
+    BOOL,
+    STR
+};
+
+struct Expression
+{
+    ExpressionKind kind;
+
+    explicit Expression(ExpressionKind kind) : kind(kind) {}
+};
+
+struct IntegerExpression : Expression
+{
+    int64_t value;
+
+    explicit IntegerExpression(int64_t value)
+        : Expression(ExpressionKind::INTEGER), value(value) {}
+};
+
+struct FloatExpression : Expression
+{
+    double value;
+
+    explicit FloatExpression(double value)
+        : Expression(ExpressionKind::FLOAT), value(value) {}
+};
+
+struct StringExpression : Expression
+{
+    std::string_view value;
+
+    explicit StringExpression(std::string_view value)
+        : Expression(ExpressionKind::STRING), value(value) {}
+};
+
+struct BoolExpression : Expression
+{
+    bool value;
+
+    explicit BoolExpression(bool value)
+        : Expression(ExpressionKind::BOOL), value(value) {}
+};
+
+struct VariableExpression : Expression
+{
+    std::string_view name;
+    uint32_t symbol;
+
+    VariableExpression(std::string_view name, uint32_t symbol)
+        : Expression(ExpressionKind::VARIABLE), name(name), symbol(symbol) {}
+};
+
+// Arithmetic: op is PLUS, MINUS, MUL or DIV.
+struct BinaryExpression : Expression
+{
+    TokenType op;
+    Expression* left;
+    Expression* right;
+
+    BinaryExpression(TokenType op, Expression* left, Expression* right)
+        : Expression(ExpressionKind::BINARY), op(op), left(left), right(right) {}
+};
+
+// `? left op right`: op is EQUAL, NOT_EQUAL, LESS or MORE.
+struct CompareExpression : Expression
+{
+    TokenType op;
+    Expression* left;
+    Expression* right;
+
+    CompareExpression(TokenType op, Expression* left, Expression* right)
+        : Expression(ExpressionKind::COMPARE), op(op), left(left), right(right) {}
+};
+
+// `name(arguments)`: a call of a user-defined function.
+struct CallExpression : Expression
+{
+    std::string_view name;
+    uint32_t symbol;
+    Expression** arguments;
+    uint32_t argument_count;
+
+    CallExpression(std::string_view name, uint32_t symbol, Expression** arguments, uint32_t argument_count)
+        : Expression(ExpressionKind::CALL), name(name), symbol(symbol), arguments(arguments), argument_count(argument_count) {}
+};
+
+// `[a, b, c]`: an array of the listed elements.
+struct ArrayExpression : Expression
+{
+    Expression** elements;
+    uint32_t element_count;
+
+    ArrayExpression(Expression** elements, uint32_t element_count)
+        : Expression(ExpressionKind::ARRAY), elements(elements), element_count(element_count) {}
+};
+
+// `[value; length]`: an array of `length` copies of `value`.
+struct ArrayFillExpression : Expression
+{
+    Expression* value;
+    uint64_t length;
+
+    ArrayFillExpression(Expression* value, uint64_t length)
+        : Expression(ExpressionKind::ARRAY_FILL), value(value), length(length) {}
+};
+
+// `name[index]`
+struct IndexExpression : Expression
+{
+    std::string_view name;
+    uint32_t symbol;
+    Expression* index;
+
+    IndexExpression(std::string_view name, uint32_t symbol, Expression* index)
+        : Expression(ExpressionKind::INDEX), name(name), symbol(symbol), index(index) {}
+};
+
+enum class StatementKind
+{
+    USE_IO,
+    USE_MODULE,
+    DECLARATION,
+    ASSIGN,
+    WRITELN,
+    EXIT,
+    WHILE,
+    FOR,
+    FUNCTION,
+    RETURN,
+    CALL,
+    INDEX_ASSIGN
+};
+
+struct Statement
+{
+    StatementKind kind;
+    Statement* next = nullptr;
+
+    explicit Statement(StatementKind kind) : kind(kind) {}
+};
+
+struct UseIoStatement : Statement
+{
+    UseIoStatement() : Statement(StatementKind::USE_IO) {}
+};
+
+// `use name;` for any module other than io, which the driver loads from
+// name.dust next to the file that uses it.
+struct UseModuleStatement : Statement
+{
+    std::string_view name;
+
+    explicit UseModuleStatement(std::string_view name)
+        : Statement(StatementKind::USE_MODULE), name(name) {}
+};
+
+// `mut name = value;` or `const name = value;`
+struct DeclarationStatement : Statement
+{
+    std::string_view name;
+    uint32_t symbol;
+    bool is_const;
+    Expression* value;
+
+    DeclarationStatement(std::string_view name, uint32_t symbol, bool is_const, Expression* value)
+        : Statement(StatementKind::DECLARATION), name(name), symbol(symbol), is_const(is_const), value(value) {}
+};
+
+struct AssignStatement : Statement
+{
+    std::string_view name;
+    uint32_t symbol;
+    Expression* value;
+
+    AssignStatement(std::string_view name, uint32_t symbol, Expression* value)
+        : Statement(StatementKind::ASSIGN), name(name), symbol(symbol), value(value) {}
+};
+
+// `name[index] = value;`
+struct IndexAssignStatement : Statement
+{
+    std::string_view name;
+    uint32_t symbol;
+    Expression* index;
+    Expression* value;
+
+    IndexAssignStatement(std::string_view name, uint32_t symbol, Expression* index, Expression* value)
+        : Statement(StatementKind::INDEX_ASSIGN), name(name), symbol(symbol), index(index), value(value) {}
+};
+
+struct WritelnStatement : Statement
+{
+    Expression* value;
+
+    explicit WritelnStatement(Expression* value)
+        : Statement(StatementKind::WRITELN), value(value) {}
+};
+
+struct ExitStatement : Statement
+{
+    Expression* value;
+
+    explicit ExitStatement(Expression* value)
+        : Statement(StatementKind::EXIT), value(value) {}
+};
+
+// Statements as a singly linked list, in source order.
+struct StatementList
+{
+    Statement* first = nullptr;
+    Statement* last = nullptr;
+    size_t count = 0;
+
+    inline void append(Statement* statement)
+    {
+        if (last == nullptr)
+            first = statement;
+        else
+            last->next = statement;
+
+        last = statement;
+        ++count;
+    }
+};
+
+// `while (condition) { body }`
+struct WhileStatement : Statement
+{
+    Expression* condition;
+    StatementList body;
+
+    WhileStatement(Expression* condition, StatementList body)
+        : Statement(StatementKind::WHILE), condition(condition), body(body) {}
+};
+
+// `for (init; condition; step) { body }`, init and step being a declaration
+// or an assignment.
+struct ForStatement : Statement
+{
+    Statement* init;
+    Expression* condition;
+    Statement* step;
+    StatementList body;
+
+    ForStatement(Statement* init, Expression* condition, Statement* step, StatementList body)
+        : Statement(StatementKind::FOR), init(init), condition(condition), step(step), body(body) {}
+};
+
+struct Parameter
+{
+    std::string_view name;
+    uint32_t symbol;
+    TypeAnnotation type;
+};
+
+// `fn name(a: int, b: float): float { body }`; the result type is optional.
+struct FunctionStatement : Statement
+{
+    std::string_view name;
+    uint32_t symbol;
+    Parameter* parameters;
+    uint32_t parameter_count;
+    TypeAnnotation return_type;
+    StatementList body;
+
+    FunctionStatement(std::string_view name, uint32_t symbol, Parameter* parameters, uint32_t parameter_count,
+                      TypeAnnotation return_type, StatementList body)
+        : Statement(StatementKind::FUNCTION), name(name), symbol(symbol), parameters(parameters),
+          parameter_count(parameter_count), return_type(return_type), body(body) {}
+};
+
+// `return value;` or `return;`
+struct ReturnStatement : Statement
+{
+    Expression* value;
+
+    explicit ReturnStatement(Expression* value)
+        : Statement(StatementKind::RETURN), value(value) {}
+};
+
+// A call whose result is discarded.
+struct CallStatement : Statement
+{
+    CallExpression* call;
+
+    explicit CallStatement(CallExpression* call)
+        : Statement(StatementKind::CALL), call(call) {}
+};
+
+struct Program
+{
+    StatementList statements;
+    // One past the highest symbol ID referenced by the program.
+    uint32_t symbol_count = 0;
+};
@@ -1,5 +1,8 @@
 #include "llvm_compiler.hpp"
+#include <cstdio>
 #include <cstdlib>
+#include <iostream>
+#include <vector>
 #include <llvm-16/llvm/ADT/APFloat.h>
 #include <llvm-16/llvm/IR/Constant.h>
 #include <llvm-16/llvm/IR/Constants.h>
@@ -7,878 +10,1772 @@
 #include <llvm-16/llvm/IR/Type.h>
 #include <llvm-16/llvm/IR/Value.h>
 #include <llvm-16/llvm/Support/Casting.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/Passes/PassBuilder.h>
+
+LLVMCompiler::LLVMCompiler(const std::string& module_name, bool fast_math)
+    : m_context(std::make_unique<llvm::LLVMContext>()), m_module(std::make_unique<llvm::Module>(module_name, *m_context)),
+      m_builder(*m_context), m_string_type(LLVMRuntime::get_string_type(*m_context)), m_fast_math(fast_math)
+    {
+        // Every floating-point instruction the builder creates carries the
+        // flags, which is what lets LoopVectorize reassociate reductions.
+        if (m_fast_math)
+        {
+            llvm::FastMathFlags flags;
+            flags.setFast();
+            m_builder.setFastMathFlags(flags);
+        }
+    }
+
+void LLVMCompiler::generate(const Program& program)
+{
+    llvm::FunctionType* func_type = llvm::FunctionType::get(m_builder.getInt64Ty(), false);
+    m_symbols.reserve(program.symbol_count);
+
+    m_main_func = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, "main", *m_module);
+    m_current_function = m_main_func;
+
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(*m_context, "entrypoint", m_main_func);
+    m_builder.SetInsertPoint(entry);
+
+    declare_functions(program);
+
+    for (const Statement* statement = program.statements.first; statement != nullptr; statement = statement->next)
+    {
+        lower_statement(statement);
+    }
+
+    emit_return(m_builder.getInt64(0));
+    finish_module();
+}
+
+// A module used by the program: only functions, which it exports, and the
+// constants they use. Constants are evaluated in a scratch function that
+// must stay empty, so only compile-time values are accepted.
+void LLVMCompiler::generate_module(const Program& program)
+{
+    m_symbols.reserve(program.symbol_count);
+    m_function_prefix = m_module->getName().str() + ".";
+    m_function_linkage = llvm::Function::ExternalLinkage;
+
+    llvm::FunctionType* init_type = llvm::FunctionType::get(m_builder.getVoidTy(), false);
+    m_main_func = llvm::Function::Create(init_type, llvm::Function::InternalLinkage, "dust.module.init", *m_module);
+    m_current_function = m_main_func;
+    m_builder.SetInsertPoint(llvm::BasicBlock::Create(*m_context, "entry", m_main_func));
+
+    declare_functions(program);
+
+    for (const Statement* statement = program.statements.first; statement != nullptr; statement = statement->next)
+    {
+        bool is_constant = statement->kind == StatementKind::DECLARATION && static_cast<const DeclarationStatement*>(statement)->is_const;
+
+        if (!is_constant && statement->kind != StatementKind::FUNCTION &&
+            statement->kind != StatementKind::USE_IO && statement->kind != StatementKind::USE_MODULE)
+        {
+            std::cerr << "Syntax error. Module '" << m_module->getName().str() << "' can only declare functions and constants." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        lower_statement(statement);
+    }
+
+    if (!m_main_func->getEntryBlock().empty())
+    {
+        std::cerr << "Syntax error. Constants of module '" << m_module->getName().str() << "' must be known at compile time." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    m_main_func->eraseFromParent();
+    m_main_func = nullptr;
+    m_current_function = nullptr;
+
+    finish_module();
+}
+
+// Every function is declared up front, so calls may come before the
+// definition and functions may call each other.
+void LLVMCompiler::declare_functions(const Program& program)
+{
+    for (const Statement* statement = program.statements.first; statement != nullptr; statement = statement->next)
+    {
+        if (statement->kind == StatementKind::FUNCTION)
+        {
+            declare_function(static_cast<const FunctionStatement*>(statement));
+        }
+    }
+}
+
+void LLVMCompiler::finish_module()
+{
+    if (m_index_error_func)
+    {
+        emit_error_function(m_index_error_func, "Error: Array index out of bounds.\n");
+    }
+
+    if (m_division_error_func)
+    {
+        emit_error_function(m_division_error_func, "Error: Integer division by zero or overflow.\n");
+    }
+
+    if (m_fast_math)
+    {
+        set_fast_math_attributes();
+    }
+
+    drop_unused_strings();
+}
+
+// Pooled strings can end up unused, e.g. a constant that was only ever
+// written out as part of coalesced output. Nothing removes them at -O0.
+void LLVMCompiler::drop_unused_strings()
+{
+    for (const auto& entry : m_string_pool)
+    {
+        llvm::GlobalVariable* global = llvm::cast<llvm::GlobalVariable>(entry.second->stripPointerCasts());
+        global->removeDeadConstantUsers();
+
+        if (global->use_empty())
+        {
+            global->eraseFromParent();
+        }
+    }
+
+    m_string_pool.clear();
+}
+
+// The function-level counterpart of the instruction flags, read by the
+// backend and by passes that look at whole functions.
+void LLVMCompiler::set_fast_math_attributes()
+{
+    for (llvm::Function& function : *m_module)
+    {
+        if (function.isDeclaration())
+        {
+            continue;
+        }
+
+        function.addFnAttr("unsafe-fp-math", "true");
+        function.addFnAttr("no-infs-fp-math", "true");
+        function.addFnAttr("no-nans-fp-math", "true");
+        function.addFnAttr("no-signed-zeros-fp-math", "true");
+        function.addFnAttr("approx-func-fp-math", "true");
+    }
+}
+
+// Returns from main, first flushing whatever the program has written.
+void LLVMCompiler::emit_return(llvm::Value* exit_code)
+{
+    if (m_runtime)
+    {
+        flush_pending_output();
+        m_builder.CreateCall(m_runtime->get_flush());
+    }
+
+    m_builder.CreateRet(exit_code);
+}
+
+void LLVMCompiler::lower_statement(const Statement* statement)
+{
+    switch (statement->kind)
+    {
+        case StatementKind::USE_IO:
+            lower_use_io();
+            break;
+        case StatementKind::USE_MODULE:
+            // Resolved by the driver, which imports the module's functions.
+            break;
+        case StatementKind::DECLARATION:
+            lower_declaration(static_cast<const DeclarationStatement*>(statement));
+            break;
+        case StatementKind::ASSIGN:
+            lower_assign(static_cast<const AssignStatement*>(statement));
+            break;
+        case StatementKind::WRITELN:
+            lower_writeln(static_cast<const WritelnStatement*>(statement));
+            break;
+        case StatementKind::EXIT:
+            lower_exit(static_cast<const ExitStatement*>(statement));
+            break;
+        case StatementKind::WHILE:
+            lower_while(static_cast<const WhileStatement*>(statement));
+            break;
+        case StatementKind::FOR:
+            lower_for(static_cast<const ForStatement*>(statement));
+            break;
+        case StatementKind::FUNCTION:
+            lower_function(static_cast<const FunctionStatement*>(statement));
+            break;
+        case StatementKind::RETURN:
+            lower_return(static_cast<const ReturnStatement*>(statement));
+            break;
+        case StatementKind::CALL:
+            lower_call(static_cast<const CallStatement*>(statement)->call);
+            break;
+        case StatementKind::INDEX_ASSIGN:
+            lower_index_assign(static_cast<const IndexAssignStatement*>(statement));
+            break;
+    }
+}
+
+void LLVMCompiler::lower_use_io()
+{
+    if(m_runtime)
+    {
+        return;
+    }
+
+    m_runtime = std::make_unique<LLVMRuntime>(*m_module, m_runtime_linkage);
+}
+
+static bool is_numeric(ValueType type)
+{
+    return type == ValueType::INTEGER || type == ValueType::FLOAT;
+}
+
+static bool is_array(ValueType type)
+{
+    return type == ValueType::INT_ARRAY || type == ValueType::FLOAT_ARRAY;
+}
+
+static ValueType get_element_type(ValueType array)
+{
+    return array == ValueType::FLOAT_ARRAY ? ValueType::FLOAT : ValueType::INTEGER;
+}
+
+static ValueType get_array_of(ValueType element)
+{
+    return element == ValueType::FLOAT ? ValueType::FLOAT_ARRAY : ValueType::INT_ARRAY;
+}
+
+// Arrays live in a global or an alloca whose type carries the length.
+static llvm::ArrayType* get_storage_type(llvm::Value* storage)
+{
+    if (llvm::GlobalVariable* global = llvm::dyn_cast<llvm::GlobalVariable>(storage))
+    {
+        return llvm::cast<llvm::ArrayType>(global->getValueType());
+    }
+
+    return llvm::cast<llvm::ArrayType>(llvm::cast<llvm::AllocaInst>(storage)->getAllocatedType());
+}
+
+LLVMCompiler::LoweredValue LLVMCompiler::get_variable(const VariableExpression* variable)
+{
+    const Symbol& symbol = m_symbols[variable->symbol];
+
+    if (!symbol.is_defined())
+    {
+        std::cerr << "Error: Variable '" << variable->name << "' not defined." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (symbol.is_const || is_array(symbol.type))
+    {
+        return { symbol.type, symbol.value };
+    }
+
+    return { symbol.type, m_builder.CreateLoad(symbol.slot->getAllocatedType(), symbol.slot, variable->name) };
+}
 
-LLVMCompiler::LLVMCompiler(const std::string& module_name, TokenBuffer tokens_buffer)
-    : m_context(), m_module(module_name, m_context), m_builder(m_context), m_tokens_buffer(std::move(tokens_buffer))
+llvm::Type* LLVMCompiler::get_llvm_type(ValueType type)
+{
+    switch (type)
     {
+        case ValueType::INTEGER:
+            return m_builder.getInt64Ty();
+        case ValueType::FLOAT:
+            return m_builder.getDoubleTy();
+        case ValueType::BOOL:
+            return m_builder.getInt1Ty();
+        case ValueType::STRING:
+            return m_string_type;
+        default:
+            throw std::runtime_error("Internal error. Value has no type.");
     }
+}
 
-void LLVMCompiler::process_use_io()
+static ValueType to_value_type(TypeAnnotation annotation)
 {
-    m_tokens_buffer.move_next();
-    check_token_type(TokenType::SEMICOLON, "Expected ';' after extern");
+    switch (annotation)
+    {
+        case TypeAnnotation::INT:
+            return ValueType::INTEGER;
+        case TypeAnnotation::FLOAT:
+            return ValueType::FLOAT;
+        case TypeAnnotation::BOOL:
+            return ValueType::BOOL;
+        case TypeAnnotation::STR:
+            return ValueType::STRING;
+        default:
+            return ValueType::UNDEFINED;
+    }
+}
 
-    m_printf_type = llvm::FunctionType::get(llvm::Type::getInt32Ty(m_context), {llvm::Type::getInt8PtrTy(m_context)}, true);
-    m_printf_func = llvm::Function::Create(m_printf_type, llvm::Function::ExternalLinkage, "printf", m_module);   
+llvm::Type* LLVMCompiler::get_llvm_type(TypeAnnotation annotation)
+{
+    if (annotation == TypeAnnotation::NONE)
+    {
+        return m_builder.getVoidTy();
+    }
 
-    use_io = true;
-    m_tokens_buffer.move_next();
+    return get_llvm_type(to_value_type(annotation));
 }
 
-TokenType LLVMCompiler::current_type() const { return m_tokens_buffer.m_current.get_type(); }
-std::string LLVMCompiler::current_value() const { return m_tokens_buffer.m_current.get_value(); }
+// Slots go to the top of the entry block, where mem2reg and SROA look for
+// them.
+llvm::AllocaInst* LLVMCompiler::create_slot(llvm::Type* type, std::string_view name)
+{
+    llvm::BasicBlock& entry = m_current_function->getEntryBlock();
+    llvm::IRBuilder<> entry_builder(&entry, entry.begin());
+
+    // Zeroed up front, so a variable declared in a loop body that never ran
+    // still reads as a defined value.
+    llvm::AllocaInst* slot = entry_builder.CreateAlloca(type, nullptr, name);
+    entry_builder.CreateStore(llvm::Constant::getNullValue(type), slot);
+
+    return slot;
+}
+
+// A variable takes the type of the last value assigned to it; a new type
+// gets a new slot.
+void LLVMCompiler::store_variable(uint32_t symbol_id, std::string_view name, LoweredValue value)
+{
+    Symbol& symbol = m_symbols[symbol_id];
+
+    // The loop header was lowered against the slot the variable had before
+    // the body, so a type change there would not be seen by the next
+    // iteration.
+    if (m_loop_depth > 0 && symbol.is_defined() && symbol.type != value.type)
+    {
+        std::cerr << "Syntax error. Variable '" << name << "' can`t change its type inside a loop." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (symbol.slot == nullptr || symbol.type != value.type)
+    {
+        symbol.slot = create_slot(get_llvm_type(value.type), name);
+    }
+
+    symbol.type = value.type;
+    m_builder.CreateStore(value.value, symbol.slot);
+}
 
-void LLVMCompiler::check_token_type(TokenType expected_type, const std::string& error_message) const
+void LLVMCompiler::lower_declaration(const DeclarationStatement* declaration)
 {
-    if(current_type() != expected_type)
+    const Symbol& symbol = m_symbols[declaration->symbol];
+
+    if (symbol.is_const)
     {
-        std::cerr << "Syntax error. " << error_message << std::endl;
+        std::cerr << "Error: Variable '" << declaration->name << "' is constant and cannot be reassigned." << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
+    if (declaration->is_const && symbol.is_defined())
+    {
+        std::cerr << "Syntax error. Redifinition of '" << declaration->name << "'" << std::endl;
         exit(EXIT_FAILURE);
     }
+
+    if (declaration->is_const && m_loop_depth > 0)
+    {
+        std::cerr << "Syntax error. Constant '" << declaration->name << "' can`t be declared inside a loop." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (is_array_expression(declaration->value))
+    {
+        assign_array(declaration->symbol, declaration->name, declaration->value, declaration->is_const);
+        return;
+    }
+
+    LoweredValue value = lower_expression(declaration->value);
+
+    if (declaration->is_const)
+    {
+        Symbol& constant = m_symbols[declaration->symbol];
+
+        constant.type = value.type;
+        constant.is_const = true;
+        constant.value = value.value;
+        return;
+    }
+
+    store_variable(declaration->symbol, declaration->name, value);
 }
 
-llvm::Value* LLVMCompiler::get_variable(const std::string& name) const
+void LLVMCompiler::lower_assign(const AssignStatement* assign)
 {
-    if (m_variables.count(name) == 0)
+    const Symbol& symbol = m_symbols[assign->symbol];
+
+    if(symbol.is_const)
     {
-        std::cerr << "Error: Variable '" << name << "' not defined." << std::endl;
+        std::cerr << "Syntax error. Variable '" << assign->name << "' is constant and cannot be reassigned" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (!symbol.is_defined()) 
+    {
+        std::cerr << "Syntax error. Undefined identifier" << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    return m_variables.at(name);
+    if (is_array_expression(assign->value))
+    {
+        assign_array(assign->symbol, assign->name, assign->value, false);
+        return;
+    }
+
+    store_variable(assign->symbol, assign->name, lower_expression(assign->value));
 }
 
-llvm::Value* LLVMCompiler::process_arithmetic(llvm::Value* left_value)
+llvm::Value* LLVMCompiler::to_float(LoweredValue value)
 {
-    while (current_type() == TokenType::PLUS || current_type() == TokenType::MINUS ||
-           current_type() == TokenType::MUL || current_type() == TokenType::DIV) 
+    if (value.type == ValueType::INTEGER)
     {
-        TokenType operation = current_type();
-        m_tokens_buffer.move_next(); 
-        llvm::Value* temp = process_expr(); 
-        switch (operation) 
+        llvm::Type* double_type = m_builder.getDoubleTy();
+
+        if (llvm::FixedVectorType* vector = llvm::dyn_cast<llvm::FixedVectorType>(value.value->getType()))
         {
-            case TokenType::PLUS:
-                left_value = m_builder.CreateFAdd(left_value, temp, "add");
-                break;
-            case TokenType::MINUS:
-                left_value = m_builder.CreateFSub(left_value, temp, "sub");
-                break;
-            case TokenType::MUL:
-                left_value = m_builder.CreateFMul(left_value, temp, "mul");
-                break;
-            case TokenType::DIV:
-                left_value = m_builder.CreateFDiv(left_value, temp, "div");
-                break;
-            default:
-                std::cerr << "Unexpected operator." << std::endl;
-                throw std::runtime_error("Unexpected operator.");
+            double_type = llvm::FixedVectorType::get(double_type, vector->getNumElements());
         }
+
+        return m_builder.CreateSIToFP(value.value, double_type, "toDouble");
     }
-    return left_value;
+
+    return value.value;
 }
 
-void LLVMCompiler::process_assign() {
-    if(m_constants.find(current_value()) != m_constants.end())
+void LLVMCompiler::lower_writeln(const WritelnStatement* writeln)
+{
+    if (!m_runtime)
     {
-        std::cerr << "Syntax error. Variable '" << current_value() << "' is constant and cannot be reassigned" << std::endl;
+        std::cerr << "Syntax error. No 'std' extern found" << std::endl;
         exit(EXIT_FAILURE);
     }
-    if (m_variables.find(current_value()) == m_variables.end() && m_string_variables.find(current_value()) == m_string_variables.end() && m_boolean_variables.find(current_value()) == m_boolean_variables.end()) 
+
+    // Literals go straight into the pending text, without a pooled copy of
+    // their own.
+    if (writeln->value->kind == ExpressionKind::STRING)
     {
-        std::cerr << "Syntax error. Undefined identifier" << std::endl;
+        m_pending_output += static_cast<const StringExpression*>(writeln->value)->value;
+        m_pending_output += '\n';
+        return;
+    }
+
+    LoweredValue value = lower_expression(writeln->value);
+
+    if (render_constant(value, m_pending_output))
+    {
+        m_pending_output += '\n';
+        return;
+    }
+
+    flush_pending_output();
+
+    switch (value.type)
+    {
+        case ValueType::INTEGER:
+            m_builder.CreateCall(m_runtime->get_write_i64(), {value.value});
+            break;
+        case ValueType::FLOAT:
+            m_builder.CreateCall(m_runtime->get_write_f64(), {value.value});
+            break;
+        case ValueType::BOOL:
+        {
+            // Branchless pick between the pooled "true" and "false".
+            llvm::Value* text = m_builder.CreateSelect(value.value, make_string("true"), make_string("false"), "boolStr");
+            m_builder.CreateCall(m_runtime->get_write_str(), {text});
+            break;
+        }
+        default:
+            m_builder.CreateCall(m_runtime->get_write_str(), {value.value});
+            break;
+    }
+
+    m_builder.CreateCall(m_runtime->get_write_str(), {make_string("\n")});
+}
+
+void LLVMCompiler::lower_while(const WhileStatement* loop)
+{
+    lower_loop(loop->condition, loop->body, nullptr);
+}
+
+void LLVMCompiler::lower_for(const ForStatement* loop)
+{
+    lower_statement(loop->init);
+    lower_loop(loop->condition, loop->body, loop->step);
+}
+
+// Canonical loop shape: the current block is the preheader, the header
+// tests the condition, the body falls through to a single latch holding
+// the step, and the latch is the only back edge. Variables stay in their
+// slots, which mem2reg turns into header phis, so LoopRotate, IndVars,
+// LoopVectorize and LoopUnroll all see the usual form.
+void LLVMCompiler::lower_loop(const Expression* condition, const StatementList& body, const Statement* step)
+{
+    flush_pending_output();
+
+    llvm::Function* function = m_builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* header = llvm::BasicBlock::Create(*m_context, "loop.header", function);
+    llvm::BasicBlock* body_block = llvm::BasicBlock::Create(*m_context, "loop.body", function);
+    llvm::BasicBlock* latch = llvm::BasicBlock::Create(*m_context, "loop.latch", function);
+    llvm::BasicBlock* exit_block = llvm::BasicBlock::Create(*m_context, "loop.exit", function);
+
+    m_builder.CreateBr(header);
+    ++m_loop_depth;
+
+    m_builder.SetInsertPoint(header);
+    LoweredValue condition_value = lower_expression(condition);
+
+    if (condition_value.type != ValueType::BOOL)
+    {
+        std::cerr << "Syntax error. Loop condition must be a boolean." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    m_builder.CreateCondBr(condition_value.value, body_block, exit_block);
+
+    m_builder.SetInsertPoint(body_block);
+
+    for (const Statement* statement = body.first; statement != nullptr; statement = statement->next)
+    {
+        lower_statement(statement);
+    }
+
+    flush_pending_output();
+    m_builder.CreateBr(latch);
+
+    m_builder.SetInsertPoint(latch);
+
+    if (step)
+    {
+        lower_statement(step);
+    }
+
+    m_builder.CreateBr(header);
+
+    --m_loop_depth;
+    m_builder.SetInsertPoint(exit_block);
+}
+
+// Renders a compile-time value exactly as the runtime would print it.
+// Returns false for values only known at run time.
+bool LLVMCompiler::render_constant(LoweredValue value, std::string& output) const
+{
+    switch (value.type)
+    {
+        case ValueType::INTEGER:
+            if (llvm::ConstantInt* constant = llvm::dyn_cast<llvm::ConstantInt>(value.value))
+            {
+                output += std::to_string(constant->getSExtValue());
+                return true;
+            }
+            return false;
+        case ValueType::FLOAT:
+            if (llvm::ConstantFP* constant = llvm::dyn_cast<llvm::ConstantFP>(value.value))
+            {
+                char text[LLVMRuntime::FLOAT_TEXT_SIZE];
+                int length = snprintf(text, sizeof(text), "%f", constant->getValueAPF().convertToDouble());
+                output.append(text, static_cast<size_t>(length));
+                return true;
+            }
+            return false;
+        case ValueType::BOOL:
+            if (llvm::ConstantInt* constant = llvm::dyn_cast<llvm::ConstantInt>(value.value))
+            {
+                output += constant->isOne() ? "true" : "false";
+                return true;
+            }
+            return false;
+        case ValueType::STRING:
+        {
+            llvm::StringRef text;
+            if (get_constant_string(value.value, text))
+            {
+                output += text;
+                return true;
+            }
+            return false;
+        }
+        default:
+            return false;
+    }
+}
+
+// Consecutive writeln calls with constant arguments are rendered at compile
+// time and written out together, with a single runtime call.
+void LLVMCompiler::flush_pending_output()
+{
+    if (m_pending_output.empty())
+    {
+        return;
+    }
+
+    m_builder.CreateCall(m_runtime->get_write_str(), {make_string(m_pending_output)});
+    m_pending_output.clear();
+}
+
+void LLVMCompiler::lower_exit(const ExitStatement* exit_statement)
+{
+    if (m_current_declaration)
+    {
+        std::cerr << "Syntax error. 'exit' can`t be used inside a function." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    LoweredValue value = lower_expression(exit_statement->value);
+
+    if (!is_numeric(value.type))
+    {
+        std::cerr << "Syntax error. Exit argument can`t be string." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (value.type == ValueType::FLOAT)
+    {
+        emit_return(m_builder.CreateFPToSI(value.value, m_builder.getInt64Ty(), "castToInt64"));
+    }
+    else
+    {
+        emit_return(value.value);
+    }
+
+    m_builder.SetInsertPoint(llvm::BasicBlock::Create(*m_context, "after_exit", m_main_func));
+}
+
+// User functions are internal to the module and use fastcc: nothing outside
+// can call them, so the optimizer is free to change their signatures, clone
+// them for constant arguments, and drop them once every call is inlined.
+void LLVMCompiler::declare_function(const FunctionStatement* function)
+{
+    llvm::Function* llvm_function = create_function(function, m_function_prefix, m_function_linkage);
+
+    if (function->body.count <= INLINE_HINT_STATEMENTS)
+    {
+        llvm_function->addFnAttr(llvm::Attribute::InlineHint);
+    }
+
+    bind_function(function->symbol, function, llvm_function);
+}
+
+// A function defined by another module of the program, bound to the symbol
+// its name has here. The linker resolves the declaration.
+void LLVMCompiler::import_function(const FunctionStatement* function, uint32_t symbol, std::string_view module)
+{
+    bind_function(symbol, function, create_function(function, std::string(module) + ".", llvm::Function::ExternalLinkage));
+}
+
+void LLVMCompiler::bind_function(uint32_t symbol_id, const FunctionStatement* function, llvm::Function* llvm_function)
+{
+    Symbol& symbol = m_symbols[symbol_id];
+
+    if (symbol.function)
+    {
+        std::cerr << "Syntax error. Redifinition of function '" << function->name << "'" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    symbol.function_declaration = function;
+    symbol.function = llvm_function;
+}
+
+llvm::Function* LLVMCompiler::create_function(const FunctionStatement* function, const std::string& prefix,
+                                              llvm::GlobalValue::LinkageTypes linkage)
+{
+    std::vector<llvm::Type*> parameter_types;
+    parameter_types.reserve(function->parameter_count);
+
+    for (uint32_t i = 0; i < function->parameter_count; ++i)
+    {
+        parameter_types.push_back(get_llvm_type(function->parameters[i].type));
+    }
+
+    llvm::FunctionType* type = llvm::FunctionType::get(get_llvm_type(function->return_type), parameter_types, false);
+
+    // Prefixed so user names never collide with main, the runtime or the
+    // functions of other modules.
+    llvm::Function* llvm_function = llvm::Function::Create(type, linkage, prefix + std::string(function->name), *m_module);
+    llvm_function->setCallingConv(llvm::CallingConv::Fast);
+    llvm_function->addFnAttr(llvm::Attribute::NoUnwind);
+
+    for (uint32_t i = 0; i < function->parameter_count; ++i)
+    {
+        llvm_function->getArg(i)->setName(std::string(function->parameters[i].name));
+    }
+
+    return llvm_function;
+}
+
+// The body is lowered where the declaration appears, so it sees the
+// constants declared before it. Parameters get slots like any mutable
+// variable.
+void LLVMCompiler::lower_function(const FunctionStatement* function)
+{
+    if (m_current_declaration || m_loop_depth > 0)
+    {
+        std::cerr << "Syntax error. Function '" << function->name << "' must be declared at the top level." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    llvm::Function* llvm_function = m_symbols[function->symbol].function;
+
+    llvm::BasicBlock* caller_block = m_builder.GetInsertBlock();
+    std::string caller_output = std::move(m_pending_output);
+    m_pending_output.clear();
+
+    m_current_function = llvm_function;
+    m_current_declaration = function;
+    m_symbols.enter_function();
+    m_builder.SetInsertPoint(llvm::BasicBlock::Create(*m_context, "entry", llvm_function));
+
+    for (uint32_t i = 0; i < function->parameter_count; ++i)
+    {
+        const Parameter& parameter = function->parameters[i];
+        m_symbols[parameter.symbol].forget_variable();
+        store_variable(parameter.symbol, parameter.name, { to_value_type(parameter.type), llvm_function->getArg(i) });
+    }
+
+    for (const Statement* statement = function->body.first; statement != nullptr; statement = statement->next)
+    {
+        lower_statement(statement);
+    }
+
+    flush_pending_output();
+
+    // Only a function that returns nothing may fall off the end. After a
+    // return the insertion block has no predecessors and is never reached.
+    llvm::BasicBlock* end_block = m_builder.GetInsertBlock();
+
+    if (function->return_type == TypeAnnotation::NONE)
+    {
+        m_builder.CreateRetVoid();
+    }
+    else if (end_block != &llvm_function->getEntryBlock() && llvm::pred_empty(end_block))
+    {
+        m_builder.CreateUnreachable();
+    }
+    else
+    {
+        std::cerr << "Syntax error. Function '" << function->name << "' can reach its end without returning a value." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    m_current_function = m_main_func;
+    m_current_declaration = nullptr;
+    m_symbols.leave_function();
+    m_pending_output = std::move(caller_output);
+    m_builder.SetInsertPoint(caller_block);
+}
+
+void LLVMCompiler::lower_return(const ReturnStatement* return_statement)
+{
+    if (!m_current_declaration)
+    {
+        std::cerr << "Syntax error. 'return' can only be used inside a function." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    TypeAnnotation return_type = m_current_declaration->return_type;
+
+    if ((return_type == TypeAnnotation::NONE) != (return_statement->value == nullptr))
+    {
+        std::cerr << "Syntax error. Function '" << m_current_declaration->name << "' "
+                  << (return_type == TypeAnnotation::NONE ? "returns nothing." : "must return a value.") << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    llvm::Value* value = nullptr;
+
+    if (return_statement->value)
+    {
+        value = convert_argument(lower_expression(return_statement->value), to_value_type(return_type), "Return value");
+    }
+
+    flush_pending_output();
+
+    if (value)
+    {
+        m_builder.CreateRet(value);
+    }
+    else
+    {
+        m_builder.CreateRetVoid();
+    }
+
+    m_builder.SetInsertPoint(llvm::BasicBlock::Create(*m_context, "after_return", m_current_function));
+}
+
+// Integers are accepted where floats are expected; nothing else converts.
+llvm::Value* LLVMCompiler::convert_argument(LoweredValue value, ValueType expected, std::string_view what)
+{
+    if (value.type == expected)
+    {
+        return value.value;
+    }
+
+    if (value.type == ValueType::INTEGER && expected == ValueType::FLOAT)
+    {
+        return to_float(value);
+    }
+
+    std::cerr << "Syntax error. " << what << " has the wrong type." << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+LLVMCompiler::LoweredValue LLVMCompiler::lower_call(const CallExpression* call)
+{
+    const Symbol& symbol = m_symbols[call->symbol];
+
+    if (!symbol.function)
+    {
+        std::cerr << "Error: Function '" << call->name << "' not defined." << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    std::string left_identifier_name = current_value();
+    const FunctionStatement* declaration = symbol.function_declaration;
+    llvm::Function* function = symbol.function;
+
+    if (call->argument_count != declaration->parameter_count)
+    {
+        std::cerr << "Syntax error. Function '" << call->name << "' takes " << declaration->parameter_count
+                  << " arguments, " << call->argument_count << " given." << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
-    m_tokens_buffer.move_next();
-    check_token_type(TokenType::ASSIGN, "Expected '=' after identifier");
-    m_tokens_buffer.move_next();
+    std::vector<llvm::Value*> arguments;
+    arguments.reserve(call->argument_count);
 
-    if(current_type() == TokenType::CHECK)
+    for (uint32_t i = 0; i < call->argument_count; ++i)
     {
-        process_check(left_identifier_name);
+        const Parameter& parameter = declaration->parameters[i];
+        std::string what = "Argument '" + std::string(parameter.name) + "' of '" + std::string(call->name) + "'";
+        arguments.push_back(convert_argument(lower_expression(call->arguments[i]), to_value_type(parameter.type), what));
+    }
+
+    // The callee may write output of its own.
+    flush_pending_output();
+
+    llvm::CallInst* result = m_builder.CreateCall(function, arguments);
+    result->setCallingConv(llvm::CallingConv::Fast);
+
+    return { to_value_type(declaration->return_type), result };
+}
+
+// Whether the expression has an array value. Only array literals, array
+// variables and arithmetic on them do.
+bool LLVMCompiler::is_array_expression(const Expression* expression)
+{
+    switch (expression->kind)
+    {
+        case ExpressionKind::ARRAY:
+        case ExpressionKind::ARRAY_FILL:
+            return true;
+        case ExpressionKind::VARIABLE:
+            return is_array(m_symbols[static_cast<const VariableExpression*>(expression)->symbol].type);
+        case ExpressionKind::BINARY:
+        {
+            const BinaryExpression* binary = static_cast<const BinaryExpression*>(expression);
+            return is_array_expression(binary->left) || is_array_expression(binary->right);
+        }
+        default:
+            return false;
     }
-    else if(current_type() == TokenType::QOUTE)
+}
+
+// Arrays have value semantics: assignment writes every element of the
+// target. Like scalars, a variable takes the shape of the last value
+// assigned to it, and a new shape gets new storage.
+void LLVMCompiler::assign_array(uint32_t symbol_id, std::string_view name, const Expression* expression, bool is_const)
+{
+    ArrayOperands operands;
+    ArrayShape shape = prepare_array(expression, operands);
+
+    ValueType type = get_array_of(shape.element);
+    llvm::ArrayType* storage_type = llvm::ArrayType::get(get_llvm_type(shape.element), shape.length);
+    Symbol& symbol = m_symbols[symbol_id];
+
+    if (is_const)
     {
-        m_tokens_buffer.move_next();
-        std::string right_string_value = current_value();
+        llvm::Constant* initializer = nullptr;
+        LoweredValue operand = operands.lookup(expression);
 
-        if(m_variables.find(left_identifier_name) != m_variables.end())
+        // Only literals known in full at compile time: a list of constants,
+        // which is already a constant global, or a constant fill value.
+        if (llvm::GlobalVariable* global = llvm::dyn_cast_or_null<llvm::GlobalVariable>(operand.value); global && global->isConstant())
         {
-            m_variables.erase(left_identifier_name);
+            symbol.type = type;
+            symbol.is_const = true;
+            symbol.value = global;
+            return;
+        }
 
-            std::string string_literal = current_value();
-            llvm::Value* str_ptr = m_builder.CreateGlobalStringPtr(string_literal);
-            llvm::Value* value = str_ptr;
-            m_tokens_buffer.move_next();
-            check_token_type(TokenType::QOUTE, "Expected '\"' after string literal");
+        if (expression->kind == ExpressionKind::ARRAY_FILL)
+        {
+            if (llvm::Constant* element = llvm::dyn_cast<llvm::Constant>(
+                    shape.element == ValueType::FLOAT ? to_float(operand) : operand.value))
+            {
+                initializer = element->isNullValue()
+                    ? static_cast<llvm::Constant*>(llvm::ConstantAggregateZero::get(storage_type))
+                    : llvm::ConstantArray::get(storage_type, std::vector<llvm::Constant*>(shape.length, element));
+            }
+        }
+
+        if (!initializer)
+        {
+            std::cerr << "Syntax error. Constant array '" << name << "' must be known at compile time." << std::endl;
+            exit(EXIT_FAILURE);
+        }
 
-            m_string_variables[left_identifier_name] = value;
-            m_tokens_buffer.move_next();
+        llvm::GlobalVariable* global = new llvm::GlobalVariable(*m_module, storage_type, true,
+                                                                llvm::GlobalValue::PrivateLinkage, initializer, name);
+        global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        global->setAlignment(llvm::Align(ARRAY_ALIGNMENT));
 
+        symbol.type = type;
+        symbol.is_const = true;
+        symbol.value = global;
+        return;
+    }
+
+    bool same_shape = symbol.type == type && get_storage_type(symbol.value) == storage_type;
+
+    if (m_loop_depth > 0 && symbol.is_defined() && !same_shape)
+    {
+        std::cerr << "Syntax error. Variable '" << name << "' can`t change its type inside a loop." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (!same_shape)
+    {
+        symbol.value = create_array_storage(storage_type, name);
+        symbol.slot = nullptr;
+    }
+
+    symbol.type = type;
+    store_array(symbol.value, shape, expression, operands);
+}
+
+// Lowers every leaf of an element-wise expression, in source order, and
+// works out the shape of the result. Scalars are evaluated once and
+// broadcast.
+LLVMCompiler::ArrayShape LLVMCompiler::prepare_array(const Expression* expression, ArrayOperands& operands)
+{
+    if (!is_array_expression(expression))
+    {
+        LoweredValue value = lower_expression(expression);
+        operands[expression] = value;
+        return { value.type, 0 };
+    }
+
+    switch (expression->kind)
+    {
+        case ExpressionKind::ARRAY:
+        {
+            LoweredValue value = lower_array_literal(static_cast<const ArrayExpression*>(expression));
+            operands[expression] = value;
+            return { get_element_type(value.type), get_storage_type(value.value)->getNumElements() };
+        }
+        case ExpressionKind::ARRAY_FILL:
+        {
+            const ArrayFillExpression* fill = static_cast<const ArrayFillExpression*>(expression);
+            LoweredValue value = lower_expression(fill->value);
+
+            if (!is_numeric(value.type))
+            {
+                std::cerr << "Syntax error. Array elements must be numbers." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            // A fill is a broadcast scalar with a length.
+            operands[expression] = value;
+            return { value.type, fill->length };
         }
-        else if(m_boolean_variables.find(left_identifier_name) != m_variables.end())
+        case ExpressionKind::VARIABLE:
         {
-            m_boolean_variables.erase(left_identifier_name);
+            LoweredValue value = get_variable(static_cast<const VariableExpression*>(expression));
+            operands[expression] = value;
+            return { get_element_type(value.type), get_storage_type(value.value)->getNumElements() };
+        }
+        default:
+        {
+            const BinaryExpression* binary = static_cast<const BinaryExpression*>(expression);
+            ArrayShape left = prepare_array(binary->left, operands);
+            ArrayShape right = prepare_array(binary->right, operands);
+
+            if (!is_numeric(left.element) || !is_numeric(right.element))
+            {
+                std::cerr << "Syntax error. Arithmetic is only defined for numbers." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            if (left.length != 0 && right.length != 0 && left.length != right.length)
+            {
+                std::cerr << "Syntax error. Arrays of length " << left.length << " and " << right.length
+                          << " can`t be combined." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+
+            ValueType element = left.element == ValueType::FLOAT || right.element == ValueType::FLOAT
+                ? ValueType::FLOAT : ValueType::INTEGER;
+
+            return { element, left.length != 0 ? left.length : right.length };
+        }
+    }
+}
+
+// A list of constants becomes a constant global; anything else is stored
+// element by element into fresh storage.
+LLVMCompiler::LoweredValue LLVMCompiler::lower_array_literal(const ArrayExpression* array)
+{
+    std::vector<LoweredValue> elements;
+    elements.reserve(array->element_count);
+    ValueType element_type = ValueType::INTEGER;
+
+    for (uint32_t i = 0; i < array->element_count; ++i)
+    {
+        LoweredValue element = lower_expression(array->elements[i]);
+
+        if (!is_numeric(element.type))
+        {
+            std::cerr << "Syntax error. Array elements must be numbers." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        if (element.type == ValueType::FLOAT)
+        {
+            element_type = ValueType::FLOAT;
+        }
+
+        elements.push_back(element);
+    }
+
+    llvm::ArrayType* storage_type = llvm::ArrayType::get(get_llvm_type(element_type), elements.size());
+    std::vector<llvm::Constant*> constants;
+    constants.reserve(elements.size());
+
+    for (LoweredValue& element : elements)
+    {
+        if (element_type == ValueType::FLOAT)
+        {
+            element = { ValueType::FLOAT, to_float(element) };
+        }
+
+        if (llvm::Constant* constant = llvm::dyn_cast<llvm::Constant>(element.value))
+        {
+            constants.push_back(constant);
+        }
+    }
+
+    ValueType type = get_array_of(element_type);
+
+    if (constants.size() == elements.size())
+    {
+        llvm::GlobalVariable* global = new llvm::GlobalVariable(*m_module, storage_type, true, llvm::GlobalValue::PrivateLinkage,
+                                                                llvm::ConstantArray::get(storage_type, constants), "array");
+        global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        global->setAlignment(llvm::Align(ARRAY_ALIGNMENT));
+
+        return { type, global };
+    }
+
+    llvm::Value* storage = create_array_storage(storage_type, "array");
+
+    for (size_t i = 0; i < elements.size(); ++i)
+    {
+        llvm::Value* pointer = m_builder.CreateConstInBoundsGEP2_64(storage_type, storage, 0, i);
+        m_builder.CreateStore(elements[i].value, pointer);
+    }
+
+    return { type, storage };
+}
+
+// Value of one element of an element-wise expression, or with no index,
+// all `vector_length` elements at once as an LLVM vector.
+LLVMCompiler::LoweredValue LLVMCompiler::lower_element(const Expression* expression, const ArrayOperands& operands,
+                                                       llvm::Value* index, uint64_t vector_length)
+{
+    auto operand = operands.find(expression);
+
+    if (operand == operands.end())
+    {
+        const BinaryExpression* binary = static_cast<const BinaryExpression*>(expression);
+        LoweredValue left = lower_element(binary->left, operands, index, vector_length);
+        LoweredValue right = lower_element(binary->right, operands, index, vector_length);
+
+        return apply_binary(binary->op, left, right);
+    }
+
+    LoweredValue value = operand->second;
+
+    if (!is_array(value.type))
+    {
+        if (!index)
+        {
+            return { value.type, m_builder.CreateVectorSplat(vector_length, value.value, "broadcast") };
+        }
+
+        return value;
+    }
 
-            std::string string_literal = current_value();
-            llvm::Value* str_ptr = m_builder.CreateGlobalStringPtr(string_literal);
-            llvm::Value* value = str_ptr;
-            m_tokens_buffer.move_next();
-            check_token_type(TokenType::QOUTE, "Expected '\"' after string literal");
+    llvm::ArrayType* storage_type = get_storage_type(value.value);
+    llvm::Type* element_type = storage_type->getElementType();
 
-            m_string_variables[left_identifier_name] = value;
-            m_tokens_buffer.move_next();
-        }
-        else
-        {
-            
-            llvm::Value* str_ptr = m_string_variables[left_identifier_name];
+    if (!index)
+    {
+        llvm::Type* vector_type = llvm::FixedVectorType::get(element_type, vector_length);
+        llvm::Value* pointer = m_builder.CreateBitCast(value.value, vector_type->getPointerTo());
 
-            llvm::Constant* new_str_ptr = m_builder.CreateGlobalStringPtr(right_string_value);
+        return { get_element_type(value.type), m_builder.CreateAlignedLoad(vector_type, pointer, llvm::Align(ARRAY_ALIGNMENT), "elements") };
+    }
 
-            str_ptr->replaceAllUsesWith(new_str_ptr);
+    llvm::Value* pointer = m_builder.CreateInBoundsGEP(storage_type, value.value, {m_builder.getInt64(0), index});
 
-            m_string_variables[left_identifier_name] = new_str_ptr;
-            m_tokens_buffer.move_next();
-                    m_tokens_buffer.move_next();
-        }
-    }
-    else if(current_type() == TokenType::IDENTIFIER && m_string_variables.find(left_identifier_name) != m_string_variables.end())
-    {
-        llvm::Value* str_ptr = m_string_variables[current_value()];
-        llvm::Value* new_str_ptr = m_string_variables[left_identifier_name];
+    return { get_element_type(value.type), m_builder.CreateLoad(element_type, pointer, "element") };
+}
 
-        str_ptr->replaceAllUsesWith(new_str_ptr);
-        m_string_variables[current_value()] = new_str_ptr;
+// Short arrays are computed as one vector operation. Longer ones get a
+// counted loop that reads each operand at the same index it writes, so
+// assigning an array expression to one of its own operands is safe and
+// LoopVectorize needs no runtime alias checks.
+void LLVMCompiler::store_array(llvm::Value* storage, ArrayShape shape, const Expression* expression, const ArrayOperands& operands)
+{
+    llvm::ArrayType* storage_type = get_storage_type(storage);
 
-        m_tokens_buffer.move_next();
-    }
-    else if(current_type() == TokenType::TRUE || current_type() == TokenType::FALSE)
+    if (shape.length <= VECTOR_LENGTH_LIMIT)
     {
-        if(m_variables.find(left_identifier_name) != m_variables.end()) 
-        {
-            m_variables.erase(left_identifier_name);
+        LoweredValue value = lower_element(expression, operands, nullptr, shape.length);
+        llvm::Value* pointer = m_builder.CreateBitCast(storage, value.value->getType()->getPointerTo());
+        m_builder.CreateAlignedStore(value.value, pointer, llvm::Align(ARRAY_ALIGNMENT));
+        return;
+    }
 
-            std::string current_bool = current_value();
-            llvm::Value* str_ptr = m_builder.CreateGlobalStringPtr(current_bool);
-            llvm::Value* value = str_ptr;
+    // Checks inside the loop would otherwise flush on every element.
+    flush_pending_output();
 
-            m_boolean_variables[left_identifier_name] = value;
+    llvm::Function* function = m_builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* preheader = m_builder.GetInsertBlock();
+    llvm::BasicBlock* body = llvm::BasicBlock::Create(*m_context, "array.body", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(*m_context, "array.exit", function);
 
-            m_tokens_buffer.move_next();
-        }
-        else if(m_boolean_variables.find(left_identifier_name) != m_boolean_variables.end())
-        {
-            m_boolean_variables.erase(left_identifier_name);
+    // Arrays are never empty, so the test goes at the bottom.
+    m_builder.CreateBr(body);
+    m_builder.SetInsertPoint(body);
 
-            std::string current_bool = current_value();
-            llvm::Value* str_ptr = m_builder.CreateGlobalStringPtr(current_bool);
-            llvm::Value* value = str_ptr;
+    llvm::PHINode* index = m_builder.CreatePHI(m_builder.getInt64Ty(), 2, "i");
+    index->addIncoming(m_builder.getInt64(0), preheader);
 
-            m_boolean_variables[left_identifier_name] = value;
+    LoweredValue value = lower_element(expression, operands, index, 0);
+    llvm::Value* pointer = m_builder.CreateInBoundsGEP(storage_type, storage, {m_builder.getInt64(0), index});
+    m_builder.CreateStore(value.value, pointer);
 
-            m_tokens_buffer.move_next();
-        }
-        else if(m_string_variables.find(left_identifier_name) != m_boolean_variables.end())
-        {
-            m_string_variables.erase(left_identifier_name);
+    llvm::Value* next = m_builder.CreateAdd(index, m_builder.getInt64(1), "i.next", true, true);
+    index->addIncoming(next, m_builder.GetInsertBlock());
+    m_builder.CreateCondBr(m_builder.CreateICmpULT(next, m_builder.getInt64(shape.length), "more"), body, done);
 
-            std::string current_bool = current_value();
-            llvm::Value* str_ptr = m_builder.CreateGlobalStringPtr(current_bool);
-            llvm::Value* value = str_ptr;
+    m_builder.SetInsertPoint(done);
+}
 
-            m_boolean_variables[left_identifier_name] = value;
+// Arrays declared in main are internal globals, so large ones do not
+// exhaust the stack; function locals are allocas, since functions may
+// recurse.
+llvm::Value* LLVMCompiler::create_array_storage(llvm::ArrayType* type, std::string_view name)
+{
+    if (m_current_function == m_main_func)
+    {
+        llvm::GlobalVariable* global = new llvm::GlobalVariable(*m_module, type, false, llvm::GlobalValue::InternalLinkage,
+                                                                llvm::ConstantAggregateZero::get(type), name);
+        global->setAlignment(llvm::Align(ARRAY_ALIGNMENT));
 
-            m_tokens_buffer.move_next();
-        }
+        return global;
     }
-    else
-    {
-        llvm::Value* right_value = process_expr();
 
-        right_value = process_arithmetic(right_value);
+    llvm::BasicBlock& entry = m_current_function->getEntryBlock();
+    llvm::IRBuilder<> entry_builder(&entry, entry.begin());
 
-        set_variable(left_identifier_name, right_value);
-    }
+    llvm::AllocaInst* storage = entry_builder.CreateAlloca(type, nullptr, name);
+    storage->setAlignment(llvm::Align(ARRAY_ALIGNMENT));
 
-    check_token_type(TokenType::SEMICOLON, "Expected for ';'");
-    m_tokens_buffer.move_next();
+    return storage;
 }
 
-void LLVMCompiler::set_variable(const std::string& name, llvm::Value* value) { m_variables[name] = value; }
-
-llvm::Value* LLVMCompiler::process_exit()
+// Address of an element, behind a bounds check. Constant indices are
+// checked here; the rest compare against the length and branch to a cold
+// error path, a compare that IndVars and CVP drop whenever the index is
+// known to be in range, as in a loop counting up to the length.
+llvm::Value* LLVMCompiler::get_element_pointer(std::string_view name, uint32_t symbol_id, const Expression* index_expression, ValueType& element)
 {
-    m_tokens_buffer.move_next();
-    check_token_type(TokenType::LPAREN, "Expected for '(");
-    m_tokens_buffer.move_next();
+    const Symbol& symbol = m_symbols[symbol_id];
 
-    if(current_type() == TokenType::IDENTIFIER && m_string_variables.find(current_value()) != m_string_variables.end())
+    if (!is_array(symbol.type))
     {
-        std::cerr << "Syntax error. Exit argument can`t be string." << std::endl;
+        std::cerr << "Syntax error. Variable '" << name << "' is not an array." << std::endl;
         exit(EXIT_FAILURE);
     }
 
-    llvm::Value* return_value = process_expr();
-
-    return_value = process_arithmetic(return_value);
-
-    llvm::Type* int64_type = llvm::Type::getInt64Ty(m_context);
-    return_value = m_builder.CreateFPToSI(return_value, int64_type, "castToInt64");
-
-    check_token_type(TokenType::RPAREN, "Expected ')'");
+    LoweredValue index = lower_expression(index_expression);
 
-    m_tokens_buffer.move_next();
-    check_token_type(TokenType::SEMICOLON, "Expected ';'");
-
-    return return_value;
-}
-
-llvm::Value* LLVMCompiler::process_expr() {
-    if (current_type() == TokenType::LPAREN) 
+    if (index.type != ValueType::INTEGER)
     {
-        m_tokens_buffer.move_next();
-        llvm::Value* value = process_expr();
-        check_token_type(TokenType::RPAREN, "Expected ')' after expression in parentheses");
-        m_tokens_buffer.move_next();
-        return value;
+        std::cerr << "Syntax error. Array index must be an integer." << std::endl;
+        exit(EXIT_FAILURE);
     }
 
-    llvm::Value* value = process_term(); 
+    llvm::ArrayType* storage_type = get_storage_type(symbol.value);
+    uint64_t length = storage_type->getNumElements();
 
-    while (current_type() == TokenType::PLUS || current_type() == TokenType::MINUS) 
+    if (llvm::ConstantInt* constant = llvm::dyn_cast<llvm::ConstantInt>(index.value))
     {
-        TokenType operation = current_type();
-        m_tokens_buffer.move_next(); 
-
-        llvm::Value* temp = process_term();         
-        if (operation == TokenType::PLUS) 
+        if (constant->getValue().uge(length))
         {
-            value = m_builder.CreateFAdd(value, temp, "add");
-        } 
-        else if (operation == TokenType::MINUS) 
-        {
-            value = m_builder.CreateFSub(value, temp, "sub");
+            std::cerr << "Syntax error. Index " << constant->getSExtValue() << " is out of bounds of '" << name << "'." << std::endl;
+            exit(EXIT_FAILURE);
         }
     }
+    else
+    {
+        llvm::Value* out_of_bounds = m_builder.CreateICmpUGE(index.value, m_builder.getInt64(length), "outOfBounds");
+        emit_check(out_of_bounds, get_error_function(m_index_error_func, "dust_index_error", {m_builder.getInt64Ty()}),
+                   {index.value}, "index");
+    }
+
+    element = get_element_type(symbol.type);
 
-    return value;
+    return m_builder.CreateInBoundsGEP(storage_type, symbol.value, {m_builder.getInt64(0), index.value}, "elementPtr");
 }
 
-llvm::Value* LLVMCompiler::process_term() {
-    llvm::Value* value = process_factor(); 
+void LLVMCompiler::lower_index_assign(const IndexAssignStatement* assign)
+{
+    if (m_symbols[assign->symbol].is_const)
+    {
+        std::cerr << "Syntax error. Variable '" << assign->name << "' is constant and cannot be reassigned" << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
-    while (current_type() == TokenType::MUL || current_type() == TokenType::DIV) {
-        TokenType operation = current_type();
-        m_tokens_buffer.move_next(); 
+    ValueType element;
+    llvm::Value* pointer = get_element_pointer(assign->name, assign->symbol, assign->index, element);
+    llvm::Value* value = convert_argument(lower_expression(assign->value), element, "Array element");
 
-        llvm::Value* temp = process_factor(); 
-        if (operation == TokenType::MUL) 
-        {
-            value = m_builder.CreateFMul(value, temp, "mul");
-        } 
-        else if (operation == TokenType::DIV) 
-        {
-            value = m_builder.CreateFDiv(value, temp, "div");
-        }
+    m_builder.CreateStore(value, pointer);
+}
+
+// Runtime errors report through a cold, out-of-line function, declared on
+// first use and defined once the whole program is lowered, when it is known
+// whether there is buffered output to flush first.
+llvm::Function* LLVMCompiler::get_error_function(llvm::Function*& function, const char* name, llvm::ArrayRef<llvm::Type*> params)
+{
+    if (!function)
+    {
+        llvm::FunctionType* type = llvm::FunctionType::get(m_builder.getVoidTy(), params, false);
+        function = llvm::Function::Create(type, llvm::Function::InternalLinkage, name, *m_module);
+        function->addFnAttr(llvm::Attribute::NoReturn);
+        function->addFnAttr(llvm::Attribute::NoUnwind);
+        function->addFnAttr(llvm::Attribute::Cold);
+        function->addFnAttr(llvm::Attribute::NoInline);
     }
 
-    return value;
+    return function;
 }
 
-llvm::Value* LLVMCompiler::process_factor() {
-    llvm::Value* value = nullptr;
+void LLVMCompiler::emit_error_function(llvm::Function* function, llvm::StringRef message)
+{
+    m_builder.SetInsertPoint(llvm::BasicBlock::Create(*m_context, "entry", function));
 
-    if (current_type() == TokenType::LPAREN) {
-        return process_expr();    
-    }
-    else if (current_type() == TokenType::INT_LITERAL || current_type() == TokenType::FLOAT_LITERAL) 
-    {
-        value = llvm::ConstantFP::get(m_builder.getDoubleTy(), std::stod(current_value()));
-        m_tokens_buffer.move_next();
-    } 
-    else if (current_type() == TokenType::IDENTIFIER) 
-    {
-        std::string assigned_variable_name = current_value();
-        value = m_variables.at(assigned_variable_name);
-        m_tokens_buffer.move_next();
-    } 
-    else 
+    if (m_runtime)
     {
-        std::cerr << "Unexpected token. Expected integer literal, identifier, or '('." << std::endl;
-        exit(EXIT_FAILURE);
+        m_builder.CreateCall(m_runtime->get_flush());
     }
 
-    return value;
-}
+    llvm::FunctionCallee write = m_module->getOrInsertFunction("write", m_builder.getInt64Ty(),
+                                                               m_builder.getInt32Ty(), m_builder.getInt8PtrTy(), m_builder.getInt64Ty());
+    llvm::FunctionCallee exit_func = m_module->getOrInsertFunction("exit", m_builder.getVoidTy(), m_builder.getInt32Ty());
 
+    m_builder.CreateCall(write, {m_builder.getInt32(2), get_string(message), m_builder.getInt64(message.size())});
+    m_builder.CreateCall(exit_func, {m_builder.getInt32(EXIT_FAILURE)});
+    m_builder.CreateUnreachable();
+}
 
-void LLVMCompiler::process_writeln()
+// Branches to a cold call of error when failed holds; lowering continues on
+// the path where it does not.
+void LLVMCompiler::emit_check(llvm::Value* failed, llvm::Function* error, llvm::ArrayRef<llvm::Value*> arguments, const llvm::Twine& name)
 {
-    m_tokens_buffer.move_next();
-    check_token_type(TokenType::LPAREN, "Expected '(' after 'writeln'.");
-    m_tokens_buffer.move_next();
+    // Constant output lowered so far has to be written before a failing
+    // check exits.
+    flush_pending_output();
 
-    if(current_type() == TokenType::QOUTE)
-    {
-        m_tokens_buffer.move_next();
+    llvm::Function* function = m_builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* ok_block = llvm::BasicBlock::Create(*m_context, name + ".ok", function);
+    llvm::BasicBlock* fail_block = llvm::BasicBlock::Create(*m_context, name + ".fail", function);
 
-        check_token_type(TokenType::STRING_LITERAL, "Expected string literal after \"");
-        std::string string_literal = m_tokens_buffer.m_current.get_value();
+    llvm::MDNode* weights = llvm::MDBuilder(*m_context).createBranchWeights(1, 1 << 20);
+    m_builder.CreateCondBr(failed, fail_block, ok_block, weights);
 
-        m_tokens_buffer.move_next();
+    m_builder.SetInsertPoint(fail_block);
+    m_builder.CreateCall(error, arguments);
+    m_builder.CreateUnreachable();
 
-        check_token_type(TokenType::QOUTE, "Expected '\"' after string literal");
-        m_tokens_buffer.move_next();
-        check_token_type(TokenType::RPAREN, "Expected ')' after '\"'");
+    m_builder.SetInsertPoint(ok_block);
+}
 
-        llvm::Constant* format_str = m_builder.CreateGlobalStringPtr("%s\n");
+// True when every lane of a comparison is known to be false.
+static bool is_known_false(llvm::Value* value)
+{
+    llvm::Constant* constant = llvm::dyn_cast<llvm::Constant>(value);
+    return constant && constant->isNullValue();
+}
 
-        m_builder.CreateCall(m_printf_func, {format_str, m_builder.CreateGlobalStringPtr(string_literal)});
-    }
-    else if(current_type() == TokenType::INT_LITERAL || current_type() == TokenType::FLOAT_LITERAL || current_type() == TokenType::LPAREN)
-    {
-        llvm::Value* format_str = nullptr;
-        if(current_type() == TokenType::INT_LITERAL)
-        {
-            format_str = m_builder.CreateGlobalStringPtr("%.0f\n");
-        }
-        else if(current_type() == TokenType::FLOAT_LITERAL)
-        {
-            format_str = m_builder.CreateGlobalStringPtr("%.6f\n");
-        }
-        else
-        {
-            format_str = m_builder.CreateGlobalStringPtr("%.6f\n");
-        }
-        llvm::Value* value = process_expr();
+// sdiv traps, or is undefined once optimized, on a zero divisor and on
+// INT64_MIN / -1. Both are rejected at compile time when the operands say
+// so, otherwise on a cold path; the checks are only emitted when the
+// operands leave them possible, so dividing by a constant costs nothing.
+// Element-wise array division checks all lanes at once.
+llvm::Value* LLVMCompiler::create_division(llvm::Value* left, llvm::Value* right)
+{
+    llvm::Type* type = right->getType();
+    llvm::Value* by_zero = m_builder.CreateICmpEQ(right, llvm::Constant::getNullValue(type), "byZero");
+    llvm::Value* overflow = m_builder.CreateICmpEQ(right, llvm::Constant::getAllOnesValue(type), "byMinusOne");
 
-        value = process_arithmetic(value);
+    if (!is_known_false(overflow))
+    {
+        llvm::Value* of_min = m_builder.CreateICmpEQ(left, llvm::ConstantInt::get(type, llvm::APInt::getSignedMinValue(64)), "ofMin");
+        overflow = is_known_false(of_min) ? of_min : m_builder.CreateAnd(overflow, of_min, "overflow");
+    }
 
-        m_builder.CreateCall(m_printf_func, {format_str, value});
+    llvm::Value* failed = is_known_false(by_zero) ? overflow
+                        : is_known_false(overflow) ? by_zero
+                        : m_builder.CreateOr(by_zero, overflow, "divFailed");
 
+    if (llvm::isa<llvm::Constant>(failed) && !is_known_false(failed))
+    {
+        std::cerr << (is_known_false(by_zero) ? "Syntax error. Integer division overflows." : "Syntax error. Integer division by zero.") << std::endl;
+        exit(EXIT_FAILURE);
     }
-    else if(current_type() == TokenType::TRUE || current_type() == TokenType::FALSE)
+
+    if (!is_known_false(failed))
     {
-        llvm::Value* format_str = nullptr;
-        std::string bool_string = current_type() == TokenType::TRUE ? "true" : "false";
-        format_str = m_builder.CreateGlobalStringPtr("%s\n");
-        llvm::Value* bool_str_ptr = m_builder.CreateGlobalStringPtr(bool_string);
-        m_builder.CreateCall(m_printf_func, {format_str, bool_str_ptr});
+        if (type->isVectorTy())
+        {
+            failed = m_builder.CreateOrReduce(failed);
+        }
 
-        m_tokens_buffer.move_next();
+        emit_check(failed, get_error_function(m_division_error_func, "dust_division_error", {}), {}, "div");
     }
-    else if(current_type() == TokenType::IDENTIFIER)
+
+    return m_builder.CreateSDiv(left, right, "div");
+}
+
+LLVMCompiler::LoweredValue LLVMCompiler::lower_expression(const Expression* expression)
+{
+    switch (expression->kind)
     {
-        if (m_variables.find(current_value()) != m_variables.end()) 
+        case ExpressionKind::INTEGER:
+            return { ValueType::INTEGER, m_builder.getInt64(static_cast<const IntegerExpression*>(expression)->value) };
+        case ExpressionKind::FLOAT:
+            return { ValueType::FLOAT, llvm::ConstantFP::get(m_builder.getDoubleTy(), static_cast<const FloatExpression*>(expression)->value) };
+        case ExpressionKind::STRING:
         {
-            std::string variable_name = current_value();
-
-            llvm::Value* format_str = nullptr;
-            llvm::Value* value = get_variable(variable_name);
-            llvm::Type* value_type = value->getType();
+            return { ValueType::STRING, make_string(static_cast<const StringExpression*>(expression)->value) };
+        }
+        case ExpressionKind::BOOL:
+            return make_bool(static_cast<const BoolExpression*>(expression)->value);
+        case ExpressionKind::VARIABLE:
+        {
+            const VariableExpression* variable = static_cast<const VariableExpression*>(expression);
+            LoweredValue value = get_variable(variable);
 
-            if(value_type->isFloatingPointTy())
-            {
-                format_str = m_builder.CreateGlobalStringPtr("%lf\n"); 
-            }
-            else
+            if (is_array(value.type))
             {
-                format_str = m_builder.CreateGlobalStringPtr("%d\n");
+                std::cerr << "Syntax error. Array '" << variable->name << "' can only be indexed or used element-wise." << std::endl;
+                exit(EXIT_FAILURE);
             }
 
-            m_builder.CreateCall(m_printf_func, {format_str, value});
+            return value;
         }
-        else if(m_boolean_variables.find(current_value()) != m_boolean_variables.end())
+        case ExpressionKind::BINARY:
+            return lower_binary(static_cast<const BinaryExpression*>(expression));
+        case ExpressionKind::COMPARE:
+            return lower_compare(static_cast<const CompareExpression*>(expression));
+        case ExpressionKind::CALL:
         {
-            std::string variable_name = current_value();
-            llvm::Value* value = m_boolean_variables[variable_name];
+            const CallExpression* call = static_cast<const CallExpression*>(expression);
+            LoweredValue result = lower_call(call);
+
+            if (result.type == ValueType::UNDEFINED)
+            {
+                std::cerr << "Syntax error. Function '" << call->name << "' returns nothing." << std::endl;
+                exit(EXIT_FAILURE);
+            }
 
-            llvm::Value* format_str = m_builder.CreateGlobalStringPtr("%s\n");
-            m_builder.CreateCall(m_printf_func, {format_str, value});
+            return result;
         }
-        else if (m_string_variables.find(current_value()) != m_string_variables.end()) 
+        case ExpressionKind::INDEX:
         {
-            std::string variable_name = current_value();
-            llvm::Value* value = m_string_variables[variable_name];
+            const IndexExpression* index = static_cast<const IndexExpression*>(expression);
+            ValueType element;
+            llvm::Value* pointer = get_element_pointer(index->name, index->symbol, index->index, element);
 
-            llvm::Value* format_str = m_builder.CreateGlobalStringPtr("%s\n");
-            m_builder.CreateCall(m_printf_func, {format_str, value});
+            return { element, m_builder.CreateLoad(get_llvm_type(element), pointer, index->name) };
         }
-        else
-        {
-            std::cerr << "Syntax error. Undefined identifier" << std::endl;
+        case ExpressionKind::ARRAY:
+        case ExpressionKind::ARRAY_FILL:
+            std::cerr << "Syntax error. Array literals can only be assigned to a variable." << std::endl;
             exit(EXIT_FAILURE);
-        } 
-    }
-    m_tokens_buffer.move_next();
-    if(current_value() == ")")
-    {
-        m_tokens_buffer.move_next();
     }
-    check_token_type(TokenType::SEMICOLON, "Expected for ';'");
-    m_tokens_buffer.move_next();
+
+    throw std::runtime_error("Unknown expression kind.");
 }
 
-void LLVMCompiler::process_global_variables(llvm::Value* left_expression, llvm::Value* right_expression, std::string left_variable_name, TokenType prev)
+LLVMCompiler::LoweredValue LLVMCompiler::lower_binary(const BinaryExpression* binary)
 {
-    if (llvm::GlobalVariable* global_left_string = llvm::dyn_cast<llvm::GlobalVariable>(left_expression)) 
-    {
-        if (llvm::GlobalVariable* global_right_string = llvm::dyn_cast<llvm::GlobalVariable>(right_expression)) 
-        {
-            llvm::ConstantDataSequential* global_left_string_data = llvm::dyn_cast<llvm::ConstantDataSequential>(global_left_string->getInitializer());
-            llvm::ConstantDataSequential* global_right_string_data = llvm::dyn_cast<llvm::ConstantDataSequential>(global_right_string->getInitializer());
-
-            if (global_left_string_data && global_right_string_data) 
-            {
-                bool is_strings_equal = global_left_string_data->getRawDataValues() == global_right_string_data->getRawDataValues();
-
-                if(prev == TokenType::NOT_EQUAL)
-                {
-                    if(!is_strings_equal)
-                    {
-                        is_strings_equal = true;
-                    }
-                    else if(is_strings_equal)
-                    {
-                        is_strings_equal = false;
-                    }
-                }
-
-                std::string bool_string = is_strings_equal ? "true" : "false";
-                llvm::Value* bool_str_ptr = m_builder.CreateGlobalStringPtr(std::move(bool_string));
-
-                m_boolean_variables[left_variable_name] = bool_str_ptr;
+    LoweredValue left = lower_expression(binary->left);
+    LoweredValue right = lower_expression(binary->right);
 
-            }
-        }
-    } 
+    return apply_binary(binary->op, left, right);
 }
 
-void LLVMCompiler::process_check(const std::string& left_variable_name)
+// Also applied to whole vectors of array elements.
+LLVMCompiler::LoweredValue LLVMCompiler::apply_binary(TokenType op, LoweredValue left, LoweredValue right)
 {
-    m_tokens_buffer.move_next();
-
-    llvm::Value* left_expression = nullptr;
-    llvm::Value* right_expression = nullptr;
-
-    if(m_variables.find(left_variable_name) != m_variables.end())
+    if (!is_numeric(left.type) || !is_numeric(right.type))
     {
-        m_variables.erase(left_variable_name);
+        std::cerr << "Syntax error. Arithmetic is only defined for numbers." << std::endl;
+        exit(EXIT_FAILURE);
     }
-    else if(m_string_variables.find(left_variable_name) != m_string_variables.end())
+
+    // Integers stay in i64 until a float operand shows up.
+    if (left.type == ValueType::INTEGER && right.type == ValueType::INTEGER)
     {
-        m_string_variables.erase(left_variable_name);
+        switch (op)
+        {
+            case TokenType::PLUS:
+                return { ValueType::INTEGER, m_builder.CreateAdd(left.value, right.value, "add") };
+            case TokenType::MINUS:
+                return { ValueType::INTEGER, m_builder.CreateSub(left.value, right.value, "sub") };
+            case TokenType::MUL:
+                return { ValueType::INTEGER, m_builder.CreateMul(left.value, right.value, "mul") };
+            case TokenType::DIV:
+                return { ValueType::INTEGER, create_division(left.value, right.value) };
+            default:
+                std::cerr << "Unexpected operator." << std::endl;
+                throw std::runtime_error("Unexpected operator.");
+        }
     }
-    else if(m_boolean_variables.find(left_variable_name) != m_boolean_variables.end())
+
+    llvm::Value* left_value = to_float(left);
+    llvm::Value* right_value = to_float(right);
+
+    switch (op)
     {
-        m_boolean_variables.erase(left_variable_name);
+        case TokenType::PLUS:
+            return { ValueType::FLOAT, m_builder.CreateFAdd(left_value, right_value, "add") };
+        case TokenType::MINUS:
+            return { ValueType::FLOAT, m_builder.CreateFSub(left_value, right_value, "sub") };
+        case TokenType::MUL:
+            return { ValueType::FLOAT, m_builder.CreateFMul(left_value, right_value, "mul") };
+        case TokenType::DIV:
+            return { ValueType::FLOAT, m_builder.CreateFDiv(left_value, right_value, "div") };
+        default:
+            std::cerr << "Unexpected operator." << std::endl;
+            throw std::runtime_error("Unexpected operator.");
     }
-    if(current_type() == TokenType::FLOAT_LITERAL || current_type() == TokenType::INT_LITERAL || current_type() == TokenType::LPAREN
-    || m_variables.find(current_value()) != m_variables.end())
-    {
-        if(current_type() == TokenType::IDENTIFIER && m_variables.find(current_value()) == m_variables.end())
-        {
-            std::cerr << "Undefined identifier: " << current_value() << std::endl;
-            exit(EXIT_FAILURE);
-        }
+}
 
-        left_expression = process_expr();
-        left_expression = process_arithmetic(left_expression);
+LLVMCompiler::LoweredValue LLVMCompiler::make_bool(bool value)
+{
+    return { ValueType::BOOL, m_builder.getInt1(value) };
+}
 
-        if(current_type() == TokenType::EQUAL || current_type() == TokenType::NOT_EQUAL)
-        {
-            TokenType equal_or_not_equal = current_type();
-            m_tokens_buffer.move_next();
-            if(current_type() == TokenType::IDENTIFIER && m_variables.find(current_value()) == m_variables.end())
-            {
-                std::cerr << "Undefined data type: " << current_value() << std::endl;
-                exit(EXIT_FAILURE);
- 
-            }
-            if(current_type() == TokenType::FLOAT_LITERAL || current_type() == TokenType::INT_LITERAL || current_type() == TokenType::IDENTIFIER || current_type() == TokenType::LPAREN)
-            {
-                right_expression = process_expr();
-                right_expression = process_arithmetic(right_expression);
+// One private global per distinct byte sequence in the module; literals and
+// format strings all go through here.
+llvm::Constant* LLVMCompiler::get_string(llvm::StringRef value)
+{
+    auto [it, inserted] = m_string_pool.try_emplace(value, nullptr);
 
-                llvm::APFloat left_expression_value = llvm::cast<llvm::ConstantFP>(left_expression)->getValueAPF();
-                llvm::APFloat right_expression_value = llvm::cast<llvm::ConstantFP>(right_expression)->getValueAPF();
+    if (inserted)
+    {
+        // Lengths travel with the pointer, so no terminating NUL.
+        llvm::Constant* bytes = llvm::ConstantDataArray::getString(*m_context, value, false);
+        llvm::GlobalVariable* global = new llvm::GlobalVariable(*m_module, bytes->getType(), true,
+                                                                llvm::GlobalValue::PrivateLinkage, bytes, "str");
+        global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        global->setAlignment(llvm::Align(1));
+
+        it->second = llvm::ConstantExpr::getInBoundsGetElementPtr(bytes->getType(), global,
+            llvm::ArrayRef<llvm::Constant*>{m_builder.getInt64(0), m_builder.getInt64(0)});
+    }
 
-                bool is_values_equal = left_expression_value.bitwiseIsEqual(right_expression_value);
+    return it->second;
+}
 
-                std::string bool_string = equal_or_not_equal == TokenType::EQUAL ? is_values_equal ? "true" : "false"
-                    : !is_values_equal ? "true" : "false";
+llvm::Constant* LLVMCompiler::make_string(llvm::StringRef value)
+{
+    return llvm::ConstantStruct::get(m_string_type, {get_string(value), m_builder.getInt64(value.size())});
+}
 
-                llvm::Value* bool_str_ptr = m_builder.CreateGlobalStringPtr(std::move(bool_string));
+// Contents of a %dust.string known at compile time.
+bool LLVMCompiler::get_constant_string(llvm::Value* value, llvm::StringRef& text)
+{
+    llvm::ConstantStruct* string = llvm::dyn_cast<llvm::ConstantStruct>(value);
 
-                m_boolean_variables[left_variable_name] = bool_str_ptr;
-            }
-            else
-            {
-                std::cerr << "Syntax error. Expected for float or literal identifier or literal after '=='" << std::endl;
-                exit(EXIT_FAILURE);
-            }
-        }
-        else if(current_type() == TokenType::LESS || current_type() == TokenType::MORE)
-        {
-            TokenType less_or_more = current_type();
-            m_tokens_buffer.move_next();
+    if (!string)
+    {
+        return false;
+    }
 
-            if(current_type() == TokenType::FLOAT_LITERAL || current_type() == TokenType::INT_LITERAL || current_type() == TokenType::IDENTIFIER)
-            {
-                right_expression = process_expr();
-                right_expression = process_arithmetic(right_expression);
+    llvm::ConstantInt* length = llvm::dyn_cast<llvm::ConstantInt>(string->getOperand(1));
 
-                llvm::APFloat left_expression_value = llvm::cast<llvm::ConstantFP>(left_expression)->getValueAPF();
-                llvm::APFloat right_expression_value = llvm::cast<llvm::ConstantFP>(right_expression)->getValueAPF();
+    if (!length || !llvm::getConstantStringInfo(string->getOperand(0), text))
+    {
+        return false;
+    }
 
-                bool is_less_or_more = less_or_more == TokenType::LESS ? left_expression_value.compare(right_expression_value) == llvm::APFloat::cmpLessThan
-                    : left_expression_value.compare(right_expression_value) == llvm::APFloat::cmpGreaterThan;
+    text = text.take_front(length->getZExtValue());
+    return true;
+}
 
-                std::string bool_string = is_less_or_more ? "true" : "false";
-                llvm::Value* bool_str_ptr = m_builder.CreateGlobalStringPtr(std::move(bool_string));
+// Equal lengths, then equal bytes. The memcmp only runs for strings of the
+// same length and only its result against zero matters, which lets LLVM
+// turn it into bcmp and expand short or constant lengths inline.
+llvm::Value* LLVMCompiler::compare_strings(LoweredValue left, LoweredValue right)
+{
+    llvm::StringRef left_string;
+    llvm::StringRef right_string;
 
-                m_boolean_variables[left_variable_name] = bool_str_ptr;
-            }
-        }
-        else
-        {
-            std::cerr << "Unexpected logical operator '" << current_value() << "'" << std::endl;
-            exit(EXIT_FAILURE);
-        }
-    }
-    else if (m_string_variables.find(current_value()) != m_string_variables.end() && current_type() == TokenType::IDENTIFIER) 
+    if (get_constant_string(left.value, left_string) && get_constant_string(right.value, right_string))
     {
-        left_expression = m_string_variables[current_value()];
+        return m_builder.getInt1(left_string == right_string);
+    }
 
-        m_tokens_buffer.move_next();
+    if (!m_memcmp_func)
+    {
+        llvm::FunctionType* memcmp_type = llvm::FunctionType::get(m_builder.getInt32Ty(),
+            {m_builder.getInt8PtrTy(), m_builder.getInt8PtrTy(), m_builder.getInt64Ty()}, false);
+        m_memcmp_func = llvm::Function::Create(memcmp_type, llvm::Function::ExternalLinkage, "memcmp", *m_module);
+    }
 
-        if (current_type() == TokenType::EQUAL || current_type() == TokenType::NOT_EQUAL) 
-        {
-            TokenType prev = current_type();
-            m_tokens_buffer.move_next();
+    llvm::Function* function = m_builder.GetInsertBlock()->getParent();
+    llvm::BasicBlock* length_check = m_builder.GetInsertBlock();
+    llvm::BasicBlock* bytes_check = llvm::BasicBlock::Create(*m_context, "compareBytes", function);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(*m_context, "compareDone", function);
 
-            if (current_type() == TokenType::QOUTE) {
-                m_tokens_buffer.move_next();
+    llvm::Value* left_length = m_builder.CreateExtractValue(left.value, 1, "leftLength");
+    llvm::Value* right_length = m_builder.CreateExtractValue(right.value, 1, "rightLength");
+    m_builder.CreateCondBr(m_builder.CreateICmpEQ(left_length, right_length, "sameLength"), bytes_check, done);
 
-                std::string right_string_literal = current_value();
-                m_tokens_buffer.move_next();
-                m_tokens_buffer.move_next();
+    m_builder.SetInsertPoint(bytes_check);
+    llvm::Value* left_data = m_builder.CreateExtractValue(left.value, 0, "leftData");
+    llvm::Value* right_data = m_builder.CreateExtractValue(right.value, 0, "rightData");
+    llvm::Value* difference = m_builder.CreateCall(m_memcmp_func, {left_data, right_data, left_length}, "difference");
+    llvm::Value* same_bytes = m_builder.CreateICmpEQ(difference, m_builder.getInt32(0), "sameBytes");
+    m_builder.CreateBr(done);
 
-                right_expression = m_builder.CreateGlobalStringPtr(std::move(right_string_literal));
+    m_builder.SetInsertPoint(done);
+    llvm::PHINode* is_equal = m_builder.CreatePHI(m_builder.getInt1Ty(), 2, "isEqual");
+    is_equal->addIncoming(m_builder.getFalse(), length_check);
+    is_equal->addIncoming(same_bytes, bytes_check);
 
-                process_global_variables(left_expression, right_expression, std::move(left_variable_name), prev);
-            }
-            else if(current_type() == TokenType::IDENTIFIER && m_string_variables.find(current_value()) != m_string_variables.end())
-            {
-                right_expression = m_string_variables[current_value()];
+    return is_equal;
+}
 
-                process_global_variables(left_expression, right_expression, std::move(left_variable_name), prev); 
+LLVMCompiler::LoweredValue LLVMCompiler::lower_compare(const CompareExpression* compare)
+{
+    LoweredValue left = lower_expression(compare->left);
+    LoweredValue right = lower_expression(compare->right);
 
-                m_tokens_buffer.move_next();
-            }
-            else
-            {
-                std::cerr << "Syntax error. You can equal only string literals or string variables." << std::endl;
-                exit(EXIT_FAILURE);
-            }
-        }
+    if (left.type != right.type && !(is_numeric(left.type) && is_numeric(right.type)))
+    {
+        std::cerr << "Syntax error. Can`t compare values of different types." << std::endl;
+        exit(EXIT_FAILURE);
     }
 
-    else if(current_type() == TokenType::QOUTE)
+    if (left.type == ValueType::INTEGER && right.type == ValueType::INTEGER)
     {
-        m_tokens_buffer.move_next();
-        std::string left_string_literal = current_value();
-        m_tokens_buffer.move_next();
-        m_tokens_buffer.move_next();
-
-        if(current_type() == TokenType::EQUAL || current_type() == TokenType::NOT_EQUAL)
+        switch (compare->op)
         {
-            TokenType prev = current_type();
-            m_tokens_buffer.move_next();
-
-            if(current_type() == TokenType::QOUTE)
-            {
-                m_tokens_buffer.move_next();
-                std::string right_string_literal = current_value();
-                m_tokens_buffer.move_next();
-
-                bool strings_equal = left_string_literal == right_string_literal;
-
-                if(prev == TokenType::NOT_EQUAL)
-                {
-                    if(!strings_equal)
-                    {
-                        strings_equal = true;
-                    }
-                    else if(strings_equal)
-                    {
-                        strings_equal = false;
-                    }
-                }
-
-                std::string bool_string = strings_equal ? "true" : "false";
-                llvm::Value* bool_str_ptr = m_builder.CreateGlobalStringPtr(std::move(bool_string));
-
-                m_boolean_variables[left_variable_name] = bool_str_ptr;
-            }
-            else if (current_type() == TokenType::IDENTIFIER && m_string_variables.find(current_value()) != m_string_variables.end()) 
-            {
-                right_expression = m_string_variables[current_value()];  
-                left_expression = m_builder.CreateGlobalStringPtr(left_string_literal);
-                
-                process_global_variables(left_expression, right_expression, std::move(left_variable_name), prev);
-
-            }
-           m_tokens_buffer.move_next();
-        }
-        else
-        {
-            std::cerr << "Unexpected logical operator '" << current_value() << "'" << std::endl;
-            exit(EXIT_FAILURE);
+            case TokenType::EQUAL:
+                return { ValueType::BOOL, m_builder.CreateICmpEQ(left.value, right.value, "eq") };
+            case TokenType::NOT_EQUAL:
+                return { ValueType::BOOL, m_builder.CreateICmpNE(left.value, right.value, "ne") };
+            case TokenType::LESS:
+                return { ValueType::BOOL, m_builder.CreateICmpSLT(left.value, right.value, "lt") };
+            default:
+                return { ValueType::BOOL, m_builder.CreateICmpSGT(left.value, right.value, "gt") };
         }
     }
-    else if(current_type() == TokenType::TRUE || current_type() == TokenType::FALSE || m_boolean_variables.find(current_value()) != m_boolean_variables.end())
-    {
-        std::string left_string_literal = current_value();
 
-        m_tokens_buffer.move_next();
+    if (is_numeric(left.type))
+    {
+        llvm::Value* left_value = to_float(left);
+        llvm::Value* right_value = to_float(right);
 
-        if(current_type() == TokenType::EQUAL || current_type() == TokenType::NOT_EQUAL)
+        switch (compare->op)
         {
-            TokenType prev = current_type();
-            m_tokens_buffer.move_next();
-
-            if(current_type() == TokenType::TRUE || current_type() == TokenType::FALSE)
-            {
-                std::string right_string_literal = current_value();
-                m_tokens_buffer.move_next();
-
-                bool strings_equal = left_string_literal == right_string_literal;
-
-                if(prev == TokenType::NOT_EQUAL)
-                {
-                    if(!strings_equal)
-                    {
-                        strings_equal = true;
-                    }
-                    else if(strings_equal)
-                    {
-                        strings_equal = false;
-                    }
-                }
-
-                std::string bool_string = strings_equal ? "true" : "false";
-                llvm::Value* bool_str_ptr = m_builder.CreateGlobalStringPtr(std::move(bool_string));
-
-                m_boolean_variables[left_variable_name] = bool_str_ptr;
-            }
-            else if(current_type() == TokenType::IDENTIFIER && m_boolean_variables.find(current_value()) != m_boolean_variables.end())
-            {
-                right_expression = m_boolean_variables[current_value()];  
-                left_expression = m_builder.CreateGlobalStringPtr(left_string_literal);
-
-                process_global_variables(left_expression, right_expression, std::move(left_variable_name), prev); 
-                if(left_variable_name.empty())
-                {
-                    std::cout << "empty" << std::endl;
-                }
-                else
-                {
-                    std::cout << "not empty" << std::endl;
-                }
-            }
+            case TokenType::EQUAL:
+                return { ValueType::BOOL, m_builder.CreateFCmpOEQ(left_value, right_value, "eq") };
+            case TokenType::NOT_EQUAL:
+                return { ValueType::BOOL, m_builder.CreateFCmpUNE(left_value, right_value, "ne") };
+            case TokenType::LESS:
+                return { ValueType::BOOL, m_builder.CreateFCmpOLT(left_value, right_value, "lt") };
+            default:
+                return { ValueType::BOOL, m_builder.CreateFCmpOGT(left_value, right_value, "gt") };
         }
     }
-    else
+
+    if (compare->op != TokenType::EQUAL && compare->op != TokenType::NOT_EQUAL)
     {
-        std::cerr << "Unexpected identifier or symbol after '?'" << std::endl;
+        std::cerr << "Syntax error. You can only check strings and booleans for equality." << std::endl;
         exit(EXIT_FAILURE);
     }
-}
 
-void LLVMCompiler::process_mut() {
-    m_tokens_buffer.move_next();
-    check_token_type(TokenType::IDENTIFIER, "Expected identifier after 'mut'");
-    std::string variable_name = current_value();
+    if (left.type == ValueType::BOOL)
+    {
+        if (compare->op == TokenType::EQUAL)
+        {
+            return { ValueType::BOOL, m_builder.CreateICmpEQ(left.value, right.value, "eq") };
+        }
 
-    if (m_constants.find(variable_name) != m_constants.end()) {
-        std::cerr << "Error: Variable '" << variable_name << "' is constant and cannot be reassigned." << std::endl;
-        exit(EXIT_FAILURE);
+        return { ValueType::BOOL, m_builder.CreateICmpNE(left.value, right.value, "ne") };
     }
 
-    m_tokens_buffer.move_next();
-    check_token_type(TokenType::ASSIGN, "Expected '=' after identifier");
-    m_tokens_buffer.move_next();
-
-    llvm::Value* value;
-    std::string right_variable_name = current_value();
+    llvm::Value* is_strings_equal = compare_strings(left, right);
 
-    if(current_type() == TokenType::CHECK)
+    if (compare->op == TokenType::EQUAL)
     {
-        process_check(std::move(variable_name));
+        return { ValueType::BOOL, is_strings_equal };
     }
-    else if(current_type() == TokenType::QOUTE)
-    {
-        m_tokens_buffer.move_next();
-        check_token_type(TokenType::STRING_LITERAL, "Expected string literal after '\"'");
 
-        std::string string_literal = current_value();
-        llvm::Value* str_ptr = m_builder.CreateGlobalStringPtr(string_literal);
-        value = str_ptr;
-        m_tokens_buffer.move_next();
-        check_token_type(TokenType::QOUTE, "Expected '\"' after string literal");
+    return { ValueType::BOOL, m_builder.CreateNot(is_strings_equal, "ne") };
+}
 
-        m_string_variables[variable_name] = value;
-        m_tokens_buffer.move_next();
-    }
-    else if (current_type() == TokenType::IDENTIFIER && m_string_variables.find(right_variable_name) != m_string_variables.end())
+std::string LLVMCompiler::get_llvm_ir_as_string() const
+{
+    std::string IRString;
+    llvm::raw_string_ostream OS(IRString);
+    m_module->print(OS, nullptr);
+    return OS.str();
+}
+ 
+llvm::Module& LLVMCompiler::get_module() { return *m_module; }
+
+llvm::orc::ThreadSafeModule LLVMCompiler::release_module()
+{
+    return llvm::orc::ThreadSafeModule(std::move(m_module), std::move(m_context));
+}
+
+void LLVMCompiler::verify_module()
+{
+    if(llvm::verifyModule(*m_module, &llvm::errs()))
     {
-        llvm::Value* str_ptr_a = m_string_variables[current_value()];
-        m_string_variables[variable_name] = str_ptr_a;
-        m_tokens_buffer.move_next();
+        std::cerr << "Internal error. Generated module is broken." << std::endl;
+        exit(EXIT_FAILURE);
     }
-    else if(current_type() == TokenType::IDENTIFIER && m_boolean_variables.find(right_variable_name) != m_boolean_variables.end())
+}
+void LLVMCompiler::optimize(const llvm::OptimizationLevel& level, llvm::TargetMachine& target_machine)
+{
+    m_module->setTargetTriple(target_machine.getTargetTriple().str());
+    m_module->setDataLayout(target_machine.createDataLayout());
+
+    // Modules export their functions only so the linker can resolve them.
+    // Once everything is in one module, only main needs to be visible,
+    // which gives the optimizer back the freedom it has with internal
+    // functions.
+    if(m_is_linked)
     {
-        llvm::Value* str_ptr_a = m_boolean_variables[current_value()];
-        m_boolean_variables[variable_name] = str_ptr_a;
-        m_tokens_buffer.move_next();
+        llvm::internalizeModule(*m_module, [](const llvm::GlobalValue& value) { return value.getName() == "main"; });
     }
-    else if (current_type() == TokenType::TRUE || current_type() == TokenType::FALSE)
-    {
-        std::string bool_string = current_type() == TokenType::TRUE ? "true" : "false";
-        llvm::Value* bool_str_ptr = m_builder.CreateGlobalStringPtr(bool_string);
-
-        m_boolean_variables[variable_name] = bool_str_ptr;
 
-        m_tokens_buffer.move_next();
-    }
-    else
+    // -O0 skips the pipeline entirely and leaves the IR exactly as it was emitted.
+    if(level == llvm::OptimizationLevel::O0)
     {
-        value = process_expr();
-        value = process_arithmetic(value);
-
-        set_variable(variable_name, value);
+        return;
     }
-    check_token_type(TokenType::SEMICOLON, "Expected for ';'");
-    m_tokens_buffer.move_next();
+
+    run_pipeline(level, target_machine, false);
 }
 
-void LLVMCompiler::process_const()
+// Function simplification for one module of a program, run on the
+// module's own thread. Loop vectorization and the rest of the late
+// pipeline wait for optimize() on the linked module, as in full LTO.
+void LLVMCompiler::optimize_before_link(const llvm::OptimizationLevel& level, llvm::TargetMachine& target_machine)
 {
-    m_tokens_buffer.move_next();
-    check_token_type(TokenType::IDENTIFIER, "Expected identifier after 'const'");
-    std::string variable_name = current_value();
+    m_module->setTargetTriple(target_machine.getTargetTriple().str());
+    m_module->setDataLayout(target_machine.createDataLayout());
 
-    if(m_variables.find(variable_name) != m_variables.end())
+    if(level == llvm::OptimizationLevel::O0)
     {
-        std::cerr << "Syntax error. Redifinition of '" << variable_name << "'" << std::endl;
-        exit(EXIT_FAILURE);
+        return;
     }
 
+    run_pipeline(level, target_machine, true);
+}
 
-    m_tokens_buffer.move_next();
-    check_token_type(TokenType::ASSIGN, "Expected '=' after identifier");
-    m_tokens_buffer.move_next();
+void LLVMCompiler::run_pipeline(const llvm::OptimizationLevel& level, llvm::TargetMachine& target_machine, bool before_link)
+{
+    llvm::LoopAnalysisManager loop_analysis_manager;
+    llvm::FunctionAnalysisManager function_analysis_manager;
+    llvm::CGSCCAnalysisManager cgscc_analysis_manager;
+    llvm::ModuleAnalysisManager module_analysis_manager;
 
-    llvm::Value* value = nullptr;
-    std::string right_variable_name = current_value();
+    llvm::PassBuilder pass_builder(&target_machine);
 
-    if(current_type() == TokenType::QOUTE)
-    {
-        m_tokens_buffer.move_next();
-        check_token_type(TokenType::STRING_LITERAL, "Expected string literal after '\"'");
+    pass_builder.registerModuleAnalyses(module_analysis_manager);
+    pass_builder.registerCGSCCAnalyses(cgscc_analysis_manager);
+    pass_builder.registerFunctionAnalyses(function_analysis_manager);
+    pass_builder.registerLoopAnalyses(loop_analysis_manager);
+    pass_builder.crossRegisterProxies(loop_analysis_manager, function_analysis_manager, cgscc_analysis_manager, module_analysis_manager);
 
-        std::string string_literal = current_value();
-        llvm::Value* str_ptr = m_builder.CreateGlobalStringPtr(string_literal);
-        value = str_ptr;
-        m_tokens_buffer.move_next();
-        check_token_type(TokenType::QOUTE, "Expected '\"' after string literal");
+    llvm::ModulePassManager module_pass_manager;
 
-        m_string_variables[variable_name] = value;
-        m_tokens_buffer.move_next();
-    }
-    else if(current_type() == TokenType::CHECK)
+    if(before_link)
     {
-        process_check(std::move(variable_name));
+        module_pass_manager = pass_builder.buildLTOPreLinkDefaultPipeline(level);
     }
-    else if (current_type() == TokenType::IDENTIFIER && m_string_variables.find(right_variable_name) != m_string_variables.end())
+    else if(m_is_linked)
     {
-        llvm::Value* str_ptr_a = m_string_variables[current_value()];
-        m_string_variables[variable_name] = str_ptr_a;
-        m_tokens_buffer.move_next();
-    }
-    else if (current_type() == TokenType::TRUE || current_type() == TokenType::FALSE)
-    {
-        std::string bool_string = current_type() == TokenType::TRUE ? "true" : "false";
-        llvm::Value* bool_str_ptr = m_builder.CreateGlobalStringPtr(bool_string);
-
-        m_boolean_variables[variable_name] = bool_str_ptr;
-
-        m_tokens_buffer.move_next();
+        module_pass_manager = pass_builder.buildLTODefaultPipeline(level, nullptr);
     }
     else
     {
-        value = process_expr();
-        value = process_arithmetic(value);
-
-        set_variable(variable_name, value);
+        module_pass_manager = pass_builder.buildPerModuleDefaultPipeline(level);
     }
 
-    m_constants.insert(variable_name);
-    check_token_type(TokenType::SEMICOLON, "Expected for ';'");
-    m_tokens_buffer.move_next();
+    module_pass_manager.run(*m_module, module_analysis_manager);
 }
 
+// Every module of a multi-module program needs this, so that the runtime
+// and its output buffer end up as one copy after linking.
+void LLVMCompiler::share_runtime()
+{
+    m_runtime_linkage = llvm::GlobalValue::LinkOnceODRLinkage;
+}
 
-void LLVMCompiler::generate()
+// Modules live in different LLVMContexts and reach the main program's
+// context as bitcode.
+llvm::SmallVector<char, 0> LLVMCompiler::write_bitcode() const
 {
-    llvm::FunctionType* func_type = llvm::FunctionType::get(m_builder.getInt64Ty(), false);
-    llvm::Function* main_func = llvm::Function::Create(func_type, llvm::Function::ExternalLinkage, "main", m_module);
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream stream(bitcode);
+    llvm::WriteBitcodeToFile(*m_module, stream);
 
-    llvm::BasicBlock* entry = llvm::BasicBlock::Create(m_context, "entrypoint", main_func);
-    m_builder.SetInsertPoint(entry);
+    return bitcode;
+}
+
+void LLVMCompiler::link_module(llvm::StringRef bitcode, llvm::StringRef name)
+{
+    llvm::Expected<std::unique_ptr<llvm::Module>> module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, name), *m_context);
 
-    for (; parse_pos < m_tokens_buffer.m_tokens.size(); ++parse_pos) 
+    if(!module)
     {
-        switch (current_type()) 
-        {
-            case TokenType::EXIT:
-                m_builder.CreateRet(process_exit());
-                break;
-            case TokenType::USE_IO:
-                process_use_io();
-                break;
-            case TokenType::WRITELN:
-                use_io ? process_writeln() : (std::cerr << "Syntax error. No 'std' extern found" << std::endl, exit(EXIT_FAILURE));
-                break;
-            case TokenType::MUT:
-                process_mut();
-                break;
-            case TokenType::CONST:
-                process_const();
-                break;
-            case TokenType::IDENTIFIER:
-                process_assign();
-                break;
-            default:
-                break;
-        }
+        throw std::runtime_error("Failed to read module '" + name.str() + "': " + llvm::toString(module.takeError()));
     }
 
-    m_builder.CreateRet(llvm::ConstantInt::get(m_builder.getInt64Ty(), 0));
-}
+    if(llvm::Linker::linkModules(*m_module, std::move(*module)))
+    {
+        throw std::runtime_error("Failed to link module '" + name.str() + "'.");
+    }
 
-std::string LLVMCompiler::get_llvm_ir_as_string() const
-{
-    std::string IRString;
-    llvm::raw_string_ostream OS(IRString);
-    m_module.print(OS, nullptr);
-    return OS.str();
+    m_is_linked = true;
 }
- 
-void LLVMCompiler::verify_module() { llvm::verifyModule(m_module); }
\ No newline at end of file
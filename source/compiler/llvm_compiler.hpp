@@ -3,67 +3,163 @@
 #include <llvm-16/llvm/IR/IRBuilder.h>
 #include <llvm-16/llvm/IR/LLVMContext.h>
 #include <llvm-16/llvm/IR/Value.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
 #include <llvm/IR/Module.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Target/TargetMachine.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Support/raw_ostream.h>
 
-#include "../token/token_buffer/token_buffer.hpp"
+#include "../ast/ast.hpp"
+#include "llvm_runtime.hpp"
+#include "symbol_table.hpp"
 
-#include <unordered_map>
+#include <memory>
 #include <cstddef>
 #include <stdexcept>
-#include <unordered_set>
+#include <string_view>
 
+// Lowers a parsed Program to LLVM IR.
 class LLVMCompiler
 {
 private:
-    llvm::LLVMContext m_context;
-    llvm::Module m_module;
+    struct LoweredValue
+    {
+        ValueType type;
+        llvm::Value* value;
+    };
+
+    // Element type and length of an array expression; scalars have length 0.
+    struct ArrayShape
+    {
+        ValueType element;
+        uint64_t length;
+    };
+
+    // Leaves of an element-wise expression, lowered once before the
+    // element loop: array storage, or scalars broadcast to every element.
+    using ArrayOperands = llvm::SmallDenseMap<const Expression*, LoweredValue, 8>;
+
+    std::unique_ptr<llvm::LLVMContext> m_context;
+    std::unique_ptr<llvm::Module> m_module;
     llvm::IRBuilder<> m_builder;
-    TokenBuffer m_tokens_buffer;
-    size_t parse_pos = 0;
-
-    TokenType current_type() const;
-    std::string current_value() const;
-
-    std::unordered_map<std::string, llvm::Value*> m_variables;
-    std::unordered_map<std::string, llvm::Value*> m_string_variables;
-    std::unordered_map<std::string, llvm::Value*> m_boolean_variables;
-    std::unordered_set<std::string> m_constants;
-
-    llvm::Value* process_exit();
-    void process_writeln();
-
-    void process_use_io();
-
-    llvm::Value* process_expr();
-    llvm::Value* process_term();
-    llvm::Value* process_factor();
-    llvm::Value* process_arithmetic(llvm::Value* left_value);
-
-    llvm::Function* m_printf_func;
-    llvm::FunctionType* m_printf_type;
-
-    void process_check(const std::string& left_variable_name);
-    void process_global_variables(llvm::Value* left_expression, llvm::Value* right_expression, std::string left_variable_name, TokenType prev);
-
-    void process_mut();
-    void process_const();
-    void process_assign(); 
-
-    llvm::Value* get_variable(const std::string& name) const;
-    void set_variable(const std::string& name, llvm::Value* value);
-
-    void check_token_type(TokenType expected_type, const std::string& error_message) const;
-
-    bool use_io = false;
+    llvm::Function* m_main_func = nullptr;
+    // Function whose body is being lowered, main included.
+    llvm::Function* m_current_function = nullptr;
+    // Declaration of the user-defined function being lowered, if any.
+    const FunctionStatement* m_current_declaration = nullptr;
+    llvm::StructType* m_string_type;
+    bool m_fast_math;
+
+    // Functions of the main program are internal; those of a module are
+    // exported under the module's name.
+    std::string m_function_prefix = "fn.";
+    llvm::GlobalValue::LinkageTypes m_function_linkage = llvm::GlobalValue::InternalLinkage;
+    llvm::GlobalValue::LinkageTypes m_runtime_linkage = llvm::GlobalValue::InternalLinkage;
+    // Set once other modules are linked in.
+    bool m_is_linked = false;
+
+    SymbolTable m_symbols;
+
+    std::unique_ptr<LLVMRuntime> m_runtime;
+    llvm::Function* m_memcmp_func = nullptr;
+    llvm::Function* m_index_error_func = nullptr;
+    llvm::Function* m_division_error_func = nullptr;
+    std::string m_pending_output;
+    // Number of loops enclosing the statement being lowered.
+    size_t m_loop_depth = 0;
+
+    llvm::StringMap<llvm::Constant*> m_string_pool;
+
+    void lower_statement(const Statement* statement);
+    void lower_use_io();
+    void lower_declaration(const DeclarationStatement* declaration);
+    void lower_assign(const AssignStatement* assign);
+    void lower_writeln(const WritelnStatement* writeln);
+    void lower_exit(const ExitStatement* exit_statement);
+    void lower_while(const WhileStatement* loop);
+    void lower_for(const ForStatement* loop);
+    void lower_loop(const Expression* condition, const StatementList& body, const Statement* step);
+    void declare_functions(const Program& program);
+    void declare_function(const FunctionStatement* function);
+    void bind_function(uint32_t symbol_id, const FunctionStatement* function, llvm::Function* llvm_function);
+    llvm::Function* create_function(const FunctionStatement* function, const std::string& prefix,
+                                    llvm::GlobalValue::LinkageTypes linkage);
+    void finish_module();
+    void lower_function(const FunctionStatement* function);
+    void lower_return(const ReturnStatement* return_statement);
+    LoweredValue lower_call(const CallExpression* call);
+    void lower_index_assign(const IndexAssignStatement* assign);
+    llvm::Value* convert_argument(LoweredValue value, ValueType expected, std::string_view what);
+
+    LoweredValue lower_expression(const Expression* expression);
+    LoweredValue lower_binary(const BinaryExpression* binary);
+    LoweredValue apply_binary(TokenType op, LoweredValue left, LoweredValue right);
+    LoweredValue lower_compare(const CompareExpression* compare);
+    LoweredValue make_bool(bool value);
+    llvm::Value* to_float(LoweredValue value);
+    llvm::Constant* get_string(llvm::StringRef value);
+    llvm::Constant* make_string(llvm::StringRef value);
+    static bool get_constant_string(llvm::Value* value, llvm::StringRef& text);
+    llvm::Value* compare_strings(LoweredValue left, LoweredValue right);
+    void emit_return(llvm::Value* exit_code);
+    void drop_unused_strings();
+
+    bool render_constant(LoweredValue value, std::string& output) const;
+    void flush_pending_output();
+
+    LoweredValue get_variable(const VariableExpression* variable);
+    void store_variable(uint32_t symbol, std::string_view name, LoweredValue value);
+    llvm::AllocaInst* create_slot(llvm::Type* type, std::string_view name);
+    llvm::Type* get_llvm_type(ValueType type);
+    llvm::Type* get_llvm_type(TypeAnnotation annotation);
+
+    bool is_array_expression(const Expression* expression);
+    void assign_array(uint32_t symbol_id, std::string_view name, const Expression* expression, bool is_const);
+    ArrayShape prepare_array(const Expression* expression, ArrayOperands& operands);
+    LoweredValue lower_array_literal(const ArrayExpression* array);
+    LoweredValue lower_element(const Expression* expression, const ArrayOperands& operands, llvm::Value* index, uint64_t vector_length);
+    void store_array(llvm::Value* storage, ArrayShape shape, const Expression* expression, const ArrayOperands& operands);
+    llvm::Value* create_array_storage(llvm::ArrayType* type, std::string_view name);
+    llvm::Value* get_element_pointer(std::string_view name, uint32_t symbol_id, const Expression* index, ValueType& element);
+    llvm::Function* get_error_function(llvm::Function*& function, const char* name, llvm::ArrayRef<llvm::Type*> params);
+    void emit_error_function(llvm::Function* function, llvm::StringRef message);
+    void emit_check(llvm::Value* failed, llvm::Function* error, llvm::ArrayRef<llvm::Value*> arguments, const llvm::Twine& name);
+    llvm::Value* create_division(llvm::Value* left, llvm::Value* right);
+    void set_fast_math_attributes();
+    void run_pipeline(const llvm::OptimizationLevel& level, llvm::TargetMachine& target_machine, bool before_link);
 
 public:
-    LLVMCompiler(const std::string& module_name, TokenBuffer tokens_buffer);
-
-    void generate();
+    // Functions with at most this many statements are marked inlinehint.
+    static constexpr size_t INLINE_HINT_STATEMENTS = 8;
+    // Array storage is aligned to a cache line, which also covers every
+    // vector register width.
+    static constexpr uint64_t ARRAY_ALIGNMENT = 64;
+    // Element-wise expressions over arrays up to this length are lowered to
+    // single vector operations, longer ones to a loop.
+    static constexpr uint64_t VECTOR_LENGTH_LIMIT = 16;
+
+    explicit LLVMCompiler(const std::string& module_name, bool fast_math = false);
+
+    void generate(const Program& program);
     void verify_module();
-
+    void optimize(const llvm::OptimizationLevel& level, llvm::TargetMachine& target_machine);
+
+    // Separate compilation. Each module of a program gets its own compiler,
+    // and so its own LLVMContext, so modules can be compiled on different
+    // threads; the main program's compiler then links the others in.
+    void generate_module(const Program& program);
+    void import_function(const FunctionStatement* function, uint32_t symbol, std::string_view module);
+    void share_runtime();
+    void optimize_before_link(const llvm::OptimizationLevel& level, llvm::TargetMachine& target_machine);
+    llvm::SmallVector<char, 0> write_bitcode() const;
+    void link_module(llvm::StringRef bitcode, llvm::StringRef name);
+
+    llvm::Module& get_module();
+    llvm::orc::ThreadSafeModule release_module();
     std::string get_llvm_ir_as_string() const;
-};
\ No newline at end of file
+};
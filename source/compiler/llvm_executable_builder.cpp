@@ -1,34 +1,51 @@
 #include "llvm_executable_builder.hpp"
 
-LLVMExecutableBuilder::LLVMExecutableBuilder(std::string llvm_ir, std::string output_file)
-    : m_llvm_ir(std::move(llvm_ir)), m_output_file(std::move(output_file)) 
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <vector>
+
+#ifdef DUST_WITH_LLD
+#include <lld/Common/CommonLinkerContext.h>
+#include <lld/Common/Driver.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+LLVMExecutableBuilder::LLVMExecutableBuilder(llvm::Module& module, llvm::TargetMachine& target_machine, std::string output_file, Linker linker)
+    : m_module(module), m_target_machine(target_machine), m_output_file(std::move(output_file)), m_linker(linker)
     {
     }
 
-void LLVMExecutableBuilder::write_llvm_ir_to_file() const
+void LLVMExecutableBuilder::emit_object_to_buffer()
 {
+    m_module.setTargetTriple(m_target_machine.getTargetTriple().str());
+    m_module.setDataLayout(m_target_machine.createDataLayout());
 
-    std::fstream out(m_output_file, std::ios::out);
+    m_object_buffer.clear();
+    llvm::raw_svector_ostream object_stream(m_object_buffer);
+    llvm::legacy::PassManager pass_manager;
 
-    if(!out.is_open())
+    if(m_target_machine.addPassesToEmitFile(pass_manager, object_stream, nullptr, llvm::CGFT_ObjectFile))
     {
-        throw std::runtime_error("Failed to open output file for writing.");
+        throw std::runtime_error("Target machine can`t emit an object file.");
     }
 
-    out << m_llvm_ir;
+    pass_manager.run(m_module);
 }
 
-void LLVMExecutableBuilder::convert_ir_to_object() const
+void LLVMExecutableBuilder::write_object_to_file() const
 {
-    std::string command = "llc -filetype=obj " + m_output_file + " -o " + m_output_file + ".o -relocation-model=pic";
-    int result = system(command.c_str());
+    std::fstream out(m_output_file + ".o", std::ios::out | std::ios::binary);
 
-    if(result != 0)
+    if(!out.is_open())
     {
-        throw std::runtime_error("Failed convert LLVM IR to object file.");
+        throw std::runtime_error("Failed to open object file for writing.");
     }
-}
 
+    out.write(m_object_buffer.data(), m_object_buffer.size());
+}
 
 void LLVMExecutableBuilder::link_objects() const
 {
@@ -41,11 +58,60 @@ void LLVMExecutableBuilder::link_objects() const
     }
 }
 
+void LLVMExecutableBuilder::link_objects_with_lld() const
+{
+#ifdef DUST_WITH_LLD
+    // lld only reads inputs by path, so the object is handed over through an
+    // anonymous in-memory file instead of being written next to the output.
+    int object_fd = memfd_create("dust_object", MFD_CLOEXEC);
 
+    if(object_fd < 0)
+    {
+        throw std::runtime_error("Failed to create in-memory object file.");
+    }
 
-void LLVMExecutableBuilder::build_executable() const
+    if(write(object_fd, m_object_buffer.data(), m_object_buffer.size()) != static_cast<ssize_t>(m_object_buffer.size()))
+    {
+        close(object_fd);
+        throw std::runtime_error("Failed to write in-memory object file.");
+    }
+
+    std::string object_path = "/proc/self/fd/" + std::to_string(object_fd);
+
+    std::vector<const char*> args = {
+        "ld.lld", "-pie", "--eh-frame-hdr",
+        "--dynamic-linker", DUST_LLD_DYNAMIC_LINKER,
+        "-o", m_output_file.c_str(),
+        DUST_LLD_SCRT1_O, DUST_LLD_CRTI_O, DUST_LLD_CRTBEGINS_O,
+        object_path.c_str(),
+        DUST_LLD_LIBC_SO,
+        DUST_LLD_CRTENDS_O, DUST_LLD_CRTN_O
+    };
+
+    bool linked = lld::elf::link(args, llvm::outs(), llvm::errs(), false, false);
+    lld::CommonLinkerContext::destroy();
+    close(object_fd);
+
+    if(!linked)
+    {
+        throw std::runtime_error("Failed to link objects with lld");
+    }
+#else
+    throw std::runtime_error("dust-lang was built without lld support. Reconfigure with -DUSE_LLD=ON.");
+#endif
+}
+
+void LLVMExecutableBuilder::build_executable()
 {
-    write_llvm_ir_to_file();
-    convert_ir_to_object();
-    link_objects();
-}
\ No newline at end of file
+    emit_object_to_buffer();
+
+    if(m_linker == Linker::LLD)
+    {
+        link_objects_with_lld();
+    }
+    else
+    {
+        write_object_to_file();
+        link_objects();
+    }
+}
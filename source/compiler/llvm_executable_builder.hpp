@@ -1,21 +1,35 @@
 #pragma once
 
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
 #include <stdexcept>
 #include <string>
 #include <fstream>
 
+enum class Linker
+{
+    CLANG,
+    LLD
+};
+
 class LLVMExecutableBuilder
 {
 private:
-    std::string m_llvm_ir;
+    llvm::Module& m_module;
+    llvm::TargetMachine& m_target_machine;
     std::string m_output_file;
+    Linker m_linker;
+    llvm::SmallVector<char, 0> m_object_buffer;
 
-    void write_llvm_ir_to_file() const;
-    void convert_ir_to_object() const;
+    void emit_object_to_buffer();
+    void write_object_to_file() const;
     void link_objects() const;
+    void link_objects_with_lld() const;
 
 public:
-    LLVMExecutableBuilder(std::string llvm_ir, std::string output_file);
+    LLVMExecutableBuilder(llvm::Module& module, llvm::TargetMachine& target_machine, std::string output_file, Linker linker = Linker::CLANG);
 
-    void build_executable() const;
-};
\ No newline at end of file
+    void build_executable();
+};
@@ -0,0 +1,77 @@
+#include "llvm_jit_runner.hpp"
+#include "llvm_target.hpp"
+
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/TargetSelect.h>
+
+LLVMJitRunner::LLVMJitRunner(llvm::orc::ThreadSafeModule module, llvm::OptimizationLevel optimization_level,
+                             TargetCpu cpu, bool fast_math)
+    : m_module(std::move(module)), m_optimization_level(optimization_level), m_cpu(std::move(cpu)), m_fast_math(fast_math)
+    {
+    }
+
+int64_t LLVMJitRunner::run()
+{
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    llvm::Expected<llvm::orc::JITTargetMachineBuilder> target_machine_builder = llvm::orc::JITTargetMachineBuilder::detectHost();
+
+    if(!target_machine_builder)
+    {
+        throw std::runtime_error("Failed to detect JIT host: " + llvm::toString(target_machine_builder.takeError()));
+    }
+
+    target_machine_builder->setCodeGenOptLevel(get_codegen_opt_level(m_optimization_level));
+
+    // detectHost already picked the host CPU and features.
+    if(!m_cpu.name.empty())
+    {
+        target_machine_builder->setCPU(m_cpu.name);
+        target_machine_builder->getFeatures() = llvm::SubtargetFeatures(m_cpu.features);
+    }
+
+    if(m_fast_math)
+    {
+        set_fast_math_options(target_machine_builder->getOptions());
+    }
+
+    llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> jit = llvm::orc::LLJITBuilder()
+        .setJITTargetMachineBuilder(std::move(*target_machine_builder))
+        .create();
+
+    if(!jit)
+    {
+        throw std::runtime_error("Failed to create JIT: " + llvm::toString(jit.takeError()));
+    }
+
+    // printf and the rest of libc are resolved from the dust-lang process itself.
+    llvm::Expected<std::unique_ptr<llvm::orc::DynamicLibrarySearchGenerator>> host_symbols =
+        llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+
+    if(!host_symbols)
+    {
+        throw std::runtime_error("Failed to expose host symbols to JIT: " + llvm::toString(host_symbols.takeError()));
+    }
+
+    (*jit)->getMainJITDylib().addGenerator(std::move(*host_symbols));
+
+    if(llvm::Error error = (*jit)->addIRModule(std::move(m_module)))
+    {
+        throw std::runtime_error("Failed to add module to JIT: " + llvm::toString(std::move(error)));
+    }
+
+    auto main_symbol = (*jit)->lookup("main");
+
+    if(!main_symbol)
+    {
+        throw std::runtime_error("Failed to find 'main' in JIT: " + llvm::toString(main_symbol.takeError()));
+    }
+
+    auto* main_func = main_symbol->toPtr<int64_t(*)()>();
+
+    return main_func();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Passes/OptimizationLevel.h>
+
+#include "llvm_target.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+
+class LLVMJitRunner
+{
+private:
+    llvm::orc::ThreadSafeModule m_module;
+    llvm::OptimizationLevel m_optimization_level;
+    TargetCpu m_cpu;
+    bool m_fast_math;
+
+public:
+    explicit LLVMJitRunner(llvm::orc::ThreadSafeModule module, llvm::OptimizationLevel optimization_level = llvm::OptimizationLevel::O0,
+                           TargetCpu cpu = {}, bool fast_math = false);
+
+    int64_t run();
+};
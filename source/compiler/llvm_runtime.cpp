@@ -0,0 +1,244 @@
+#include "llvm_runtime.hpp"
+
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/IR/MDBuilder.h>
+
+LLVMRuntime::LLVMRuntime(llvm::Module& module, llvm::GlobalValue::LinkageTypes linkage)
+    : m_module(module), m_context(module.getContext()), m_builder(m_context), m_linkage(linkage)
+    {
+        m_string_type = get_string_type(m_context);
+        m_buffer_type = llvm::ArrayType::get(m_builder.getInt8Ty(), BUFFER_SIZE);
+        m_buffer = new llvm::GlobalVariable(m_module, m_buffer_type, false, m_linkage,
+                                            llvm::ConstantAggregateZero::get(m_buffer_type), "dust_output_buffer");
+        m_buffer->setAlignment(llvm::Align(64));
+
+        m_buffer_used = new llvm::GlobalVariable(m_module, m_builder.getInt64Ty(), false, m_linkage,
+                                                 m_builder.getInt64(0), "dust_output_used");
+
+        llvm::FunctionType* write_type = llvm::FunctionType::get(m_builder.getInt64Ty(),
+            {m_builder.getInt32Ty(), m_builder.getInt8PtrTy(), m_builder.getInt64Ty()}, false);
+        m_write_syscall = llvm::Function::Create(write_type, llvm::Function::ExternalLinkage, "write", m_module);
+
+        llvm::FunctionType* snprintf_type = llvm::FunctionType::get(m_builder.getInt32Ty(),
+            {m_builder.getInt8PtrTy(), m_builder.getInt64Ty(), m_builder.getInt8PtrTy()}, true);
+        m_snprintf = llvm::Function::Create(snprintf_type, llvm::Function::ExternalLinkage, "snprintf", m_module);
+
+        m_write_all = create_function("dust_write_all", m_builder.getVoidTy(), {m_builder.getInt8PtrTy(), m_builder.getInt64Ty()});
+        m_flush = create_function("dust_flush", m_builder.getVoidTy(), {});
+        m_write_str = create_function("dust_write_str", m_builder.getVoidTy(), {m_string_type});
+        m_write_str_slow = create_function("dust_write_str_slow", m_builder.getVoidTy(), {m_builder.getInt8PtrTy(), m_builder.getInt64Ty()});
+        m_write_i64 = create_function("dust_write_i64", m_builder.getVoidTy(), {m_builder.getInt64Ty()});
+        m_write_f64 = create_function("dust_write_f64", m_builder.getVoidTy(), {m_builder.getDoubleTy()});
+
+        emit_write_all();
+        emit_flush();
+        emit_write_str();
+        emit_write_str_slow();
+        emit_write_i64();
+        emit_write_f64();
+
+        // Everything but the buffered copy stays out of line.
+        for (llvm::Function* function : {m_write_all, m_flush, m_write_str_slow, m_write_i64, m_write_f64})
+        {
+            function->addFnAttr(llvm::Attribute::NoInline);
+        }
+        for (llvm::Function* function : {m_write_all, m_write_str_slow})
+        {
+            function->addFnAttr(llvm::Attribute::Cold);
+        }
+    }
+
+llvm::StructType* LLVMRuntime::get_string_type(llvm::LLVMContext& context)
+{
+    if (llvm::StructType* string_type = llvm::StructType::getTypeByName(context, "dust.string"))
+    {
+        return string_type;
+    }
+
+    return llvm::StructType::create(context, {llvm::Type::getInt8PtrTy(context), llvm::Type::getInt64Ty(context)}, "dust.string");
+}
+
+llvm::Value* LLVMRuntime::make_string(llvm::Value* data, llvm::Value* length)
+{
+    llvm::Value* string = m_builder.CreateInsertValue(llvm::PoisonValue::get(m_string_type), data, 0);
+
+    return m_builder.CreateInsertValue(string, length, 1);
+}
+
+llvm::Function* LLVMRuntime::create_function(const char* name, llvm::Type* return_type, llvm::ArrayRef<llvm::Type*> params)
+{
+    llvm::FunctionType* type = llvm::FunctionType::get(return_type, params, false);
+    llvm::Function* function = llvm::Function::Create(type, m_linkage, name, m_module);
+    function->addFnAttr(llvm::Attribute::NoUnwind);
+
+    return function;
+}
+
+// Hands len bytes to write(2), retrying short writes. Gives up on error.
+void LLVMRuntime::emit_write_all()
+{
+    llvm::Argument* data = m_write_all->getArg(0);
+    llvm::Argument* length = m_write_all->getArg(1);
+
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(m_context, "entry", m_write_all);
+    llvm::BasicBlock* loop = llvm::BasicBlock::Create(m_context, "loop", m_write_all);
+    llvm::BasicBlock* advance = llvm::BasicBlock::Create(m_context, "advance", m_write_all);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(m_context, "done", m_write_all);
+
+    m_builder.SetInsertPoint(entry);
+    m_builder.CreateCondBr(m_builder.CreateICmpEQ(length, m_builder.getInt64(0)), done, loop);
+
+    m_builder.SetInsertPoint(loop);
+    llvm::PHINode* position = m_builder.CreatePHI(m_builder.getInt64Ty(), 2, "position");
+    position->addIncoming(m_builder.getInt64(0), entry);
+
+    llvm::Value* cursor = m_builder.CreateInBoundsGEP(m_builder.getInt8Ty(), data, position);
+    llvm::Value* written = m_builder.CreateCall(m_write_syscall,
+        {m_builder.getInt32(1), cursor, m_builder.CreateSub(length, position)}, "written");
+    m_builder.CreateCondBr(m_builder.CreateICmpSGT(written, m_builder.getInt64(0)), advance, done);
+
+    m_builder.SetInsertPoint(advance);
+    llvm::Value* next_position = m_builder.CreateAdd(position, written);
+    position->addIncoming(next_position, advance);
+    m_builder.CreateCondBr(m_builder.CreateICmpULT(next_position, length), loop, done);
+
+    m_builder.SetInsertPoint(done);
+    m_builder.CreateRetVoid();
+}
+
+void LLVMRuntime::emit_flush()
+{
+    m_builder.SetInsertPoint(llvm::BasicBlock::Create(m_context, "entry", m_flush));
+
+    llvm::Value* used = m_builder.CreateLoad(m_builder.getInt64Ty(), m_buffer_used, "used");
+    llvm::Value* data = m_builder.CreateConstInBoundsGEP2_64(m_buffer_type, m_buffer, 0, 0);
+
+    m_builder.CreateCall(m_write_all, {data, used});
+    m_builder.CreateStore(m_builder.getInt64(0), m_buffer_used);
+    m_builder.CreateRetVoid();
+}
+
+// Appends to the buffer. Only the bounds check and the copy are meant to
+// be inlined; a full buffer goes through dust_write_str_slow.
+void LLVMRuntime::emit_write_str()
+{
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(m_context, "entry", m_write_str);
+    llvm::BasicBlock* copy = llvm::BasicBlock::Create(m_context, "copy", m_write_str);
+    llvm::BasicBlock* spill = llvm::BasicBlock::Create(m_context, "spill", m_write_str);
+
+    m_builder.SetInsertPoint(entry);
+    llvm::Value* data = m_builder.CreateExtractValue(m_write_str->getArg(0), 0, "data");
+    llvm::Value* length = m_builder.CreateExtractValue(m_write_str->getArg(0), 1, "length");
+    llvm::Value* used = m_builder.CreateLoad(m_builder.getInt64Ty(), m_buffer_used, "used");
+    llvm::Value* fits = m_builder.CreateICmpULE(m_builder.CreateAdd(used, length), m_builder.getInt64(BUFFER_SIZE));
+    llvm::MDNode* likely = llvm::MDBuilder(m_context).createBranchWeights(2000, 1);
+    m_builder.CreateCondBr(fits, copy, spill, likely);
+
+    m_builder.SetInsertPoint(copy);
+    llvm::Value* destination = m_builder.CreateInBoundsGEP(m_buffer_type, m_buffer, {m_builder.getInt64(0), used});
+    m_builder.CreateMemCpy(destination, llvm::MaybeAlign(1), data, llvm::MaybeAlign(1), length);
+    m_builder.CreateStore(m_builder.CreateAdd(used, length), m_buffer_used);
+    m_builder.CreateRetVoid();
+
+    m_builder.SetInsertPoint(spill);
+    m_builder.CreateCall(m_write_str_slow, {data, length});
+    m_builder.CreateRetVoid();
+}
+
+// Flushes, then either buffers the chunk or, when it is larger than the
+// whole buffer, writes it out directly.
+void LLVMRuntime::emit_write_str_slow()
+{
+    llvm::Argument* data = m_write_str_slow->getArg(0);
+    llvm::Argument* length = m_write_str_slow->getArg(1);
+
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(m_context, "entry", m_write_str_slow);
+    llvm::BasicBlock* direct = llvm::BasicBlock::Create(m_context, "direct", m_write_str_slow);
+    llvm::BasicBlock* copy = llvm::BasicBlock::Create(m_context, "copy", m_write_str_slow);
+
+    m_builder.SetInsertPoint(entry);
+    m_builder.CreateCall(m_flush);
+    m_builder.CreateCondBr(m_builder.CreateICmpUGT(length, m_builder.getInt64(BUFFER_SIZE)), direct, copy);
+
+    m_builder.SetInsertPoint(direct);
+    m_builder.CreateCall(m_write_all, {data, length});
+    m_builder.CreateRetVoid();
+
+    m_builder.SetInsertPoint(copy);
+    llvm::Value* destination = m_builder.CreateConstInBoundsGEP2_64(m_buffer_type, m_buffer, 0, 0);
+    m_builder.CreateMemCpy(destination, llvm::MaybeAlign(1), data, llvm::MaybeAlign(1), length);
+    m_builder.CreateStore(length, m_buffer_used);
+    m_builder.CreateRetVoid();
+}
+
+// Renders the decimal digits right to left into a stack buffer. Works on
+// the magnitude as unsigned so INT64_MIN needs no special case.
+void LLVMRuntime::emit_write_i64()
+{
+    constexpr uint64_t text_size = 24;
+
+    llvm::Argument* value = m_write_i64->getArg(0);
+    llvm::ArrayType* text_type = llvm::ArrayType::get(m_builder.getInt8Ty(), text_size);
+
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(m_context, "entry", m_write_i64);
+    llvm::BasicBlock* digits = llvm::BasicBlock::Create(m_context, "digits", m_write_i64);
+    llvm::BasicBlock* sign = llvm::BasicBlock::Create(m_context, "sign", m_write_i64);
+    llvm::BasicBlock* output = llvm::BasicBlock::Create(m_context, "output", m_write_i64);
+
+    m_builder.SetInsertPoint(entry);
+    llvm::Value* text = m_builder.CreateAlloca(text_type, nullptr, "text");
+    llvm::Value* is_negative = m_builder.CreateICmpSLT(value, m_builder.getInt64(0), "isNegative");
+    llvm::Value* magnitude = m_builder.CreateSelect(is_negative, m_builder.CreateNeg(value), value, "magnitude");
+    m_builder.CreateBr(digits);
+
+    m_builder.SetInsertPoint(digits);
+    llvm::PHINode* index = m_builder.CreatePHI(m_builder.getInt64Ty(), 2, "index");
+    llvm::PHINode* rest = m_builder.CreatePHI(m_builder.getInt64Ty(), 2, "rest");
+    index->addIncoming(m_builder.getInt64(text_size), entry);
+    rest->addIncoming(magnitude, entry);
+
+    llvm::Value* digit_index = m_builder.CreateSub(index, m_builder.getInt64(1));
+    llvm::Value* quotient = m_builder.CreateUDiv(rest, m_builder.getInt64(10));
+    llvm::Value* digit = m_builder.CreateSub(rest, m_builder.CreateMul(quotient, m_builder.getInt64(10)));
+    llvm::Value* digit_char = m_builder.CreateAdd(m_builder.CreateTrunc(digit, m_builder.getInt8Ty()), m_builder.getInt8('0'));
+    m_builder.CreateStore(digit_char, m_builder.CreateInBoundsGEP(text_type, text, {m_builder.getInt64(0), digit_index}));
+
+    index->addIncoming(digit_index, digits);
+    rest->addIncoming(quotient, digits);
+    m_builder.CreateCondBr(m_builder.CreateICmpNE(quotient, m_builder.getInt64(0)), digits, sign);
+
+    m_builder.SetInsertPoint(sign);
+    llvm::Value* sign_index = m_builder.CreateSub(digit_index, m_builder.getInt64(1));
+    m_builder.CreateStore(m_builder.getInt8('-'), m_builder.CreateInBoundsGEP(text_type, text, {m_builder.getInt64(0), sign_index}));
+    llvm::Value* start = m_builder.CreateSelect(is_negative, sign_index, digit_index, "start");
+    m_builder.CreateBr(output);
+
+    m_builder.SetInsertPoint(output);
+    llvm::Value* data = m_builder.CreateInBoundsGEP(text_type, text, {m_builder.getInt64(0), start});
+    m_builder.CreateCall(m_write_str, {make_string(data, m_builder.CreateSub(m_builder.getInt64(text_size), start))});
+    m_builder.CreateRetVoid();
+}
+
+void LLVMRuntime::emit_write_f64()
+{
+    llvm::Argument* value = m_write_f64->getArg(0);
+    llvm::ArrayType* text_type = llvm::ArrayType::get(m_builder.getInt8Ty(), FLOAT_TEXT_SIZE);
+
+    m_builder.SetInsertPoint(llvm::BasicBlock::Create(m_context, "entry", m_write_f64));
+
+    llvm::Value* text = m_builder.CreateAlloca(text_type, nullptr, "text");
+    llvm::Value* data = m_builder.CreateConstInBoundsGEP2_64(text_type, text, 0, 0);
+    llvm::Value* format = m_builder.CreateGlobalStringPtr("%f", "float_format");
+
+    llvm::Value* printed = m_builder.CreateCall(m_snprintf, {data, m_builder.getInt64(FLOAT_TEXT_SIZE), format, value}, "printed");
+    llvm::Value* length = m_builder.CreateSExt(printed, m_builder.getInt64Ty());
+
+    // snprintf reports errors as a negative count: print nothing then.
+    llvm::Value* in_range = m_builder.CreateICmpULT(length, m_builder.getInt64(FLOAT_TEXT_SIZE));
+    length = m_builder.CreateSelect(in_range, length, m_builder.getInt64(0));
+
+    m_builder.CreateCall(m_write_str, {make_string(data, length)});
+    m_builder.CreateRetVoid();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalVariable.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+#include <cstdint>
+
+// Buffered output runtime, emitted as IR into the module that uses it.
+// Output is collected in one internal buffer and handed to write(2) when
+// the buffer fills up and when the program returns. The entry points have
+// internal linkage; dust_write_str is small enough for the optimizer to
+// inline, while its flushing slow path and the formatters stay out of line.
+//
+//   dust_write_str(string)     dust_write_i64(value)
+//   dust_write_f64(value)      dust_flush()
+//
+// Strings are passed as %dust.string, a { ptr, i64 } pair of the bytes and
+// their length; nothing is NUL-terminated.
+//
+// Programs split into modules emit the runtime in every module that uses io
+// with linkonce_odr linkage, so linking leaves one shared buffer.
+class LLVMRuntime
+{
+public:
+    static constexpr uint64_t BUFFER_SIZE = 64 * 1024;
+    // Longest "%f" rendering of a double, plus the terminating NUL.
+    static constexpr uint64_t FLOAT_TEXT_SIZE = 320;
+
+private:
+    llvm::Module& m_module;
+    llvm::LLVMContext& m_context;
+    llvm::IRBuilder<> m_builder;
+    llvm::GlobalValue::LinkageTypes m_linkage;
+
+    llvm::StructType* m_string_type;
+    llvm::ArrayType* m_buffer_type;
+    llvm::GlobalVariable* m_buffer;
+    llvm::GlobalVariable* m_buffer_used;
+
+    llvm::Function* m_write_syscall;
+    llvm::Function* m_snprintf;
+
+    llvm::Function* m_write_all;
+    llvm::Function* m_flush;
+    llvm::Function* m_write_str;
+    llvm::Function* m_write_str_slow;
+    llvm::Function* m_write_i64;
+    llvm::Function* m_write_f64;
+
+    llvm::Function* create_function(const char* name, llvm::Type* return_type, llvm::ArrayRef<llvm::Type*> params);
+    llvm::Value* make_string(llvm::Value* data, llvm::Value* length);
+
+    void emit_write_all();
+    void emit_flush();
+    void emit_write_str();
+    void emit_write_str_slow();
+    void emit_write_i64();
+    void emit_write_f64();
+
+public:
+    explicit LLVMRuntime(llvm::Module& module, llvm::GlobalValue::LinkageTypes linkage = llvm::GlobalValue::InternalLinkage);
+
+    static llvm::StructType* get_string_type(llvm::LLVMContext& context);
+
+    inline llvm::Function* get_flush() const { return m_flush; }
+    inline llvm::Function* get_write_str() const { return m_write_str; }
+    inline llvm::Function* get_write_i64() const { return m_write_i64; }
+    inline llvm::Function* get_write_f64() const { return m_write_f64; }
+};
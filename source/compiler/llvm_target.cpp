@@ -0,0 +1,98 @@
+#include "llvm_target.hpp"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/MC/SubtargetFeature.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetOptions.h>
+
+#include <mutex>
+
+TargetCpu resolve_target_cpu(const std::string& cpu)
+{
+    if(cpu != "native")
+    {
+        return { cpu, "" };
+    }
+
+    // The CPU name alone misses features the host has switched off, such
+    // as AVX-512 on parts where the OS does not save its registers.
+    llvm::SubtargetFeatures features;
+    llvm::StringMap<bool> host_features;
+
+    if(llvm::sys::getHostCPUFeatures(host_features))
+    {
+        for(const llvm::StringMapEntry<bool>& feature : host_features)
+        {
+            features.AddFeature(feature.getKey(), feature.getValue());
+        }
+    }
+
+    return { llvm::sys::getHostCPUName().str(), features.getString() };
+}
+
+void set_fast_math_options(llvm::TargetOptions& options)
+{
+    options.UnsafeFPMath = true;
+    options.NoInfsFPMath = true;
+    options.NoNaNsFPMath = true;
+    options.NoSignedZerosFPMath = true;
+    options.AllowFPOpFusion = llvm::FPOpFusion::Fast;
+}
+
+llvm::CodeGenOpt::Level get_codegen_opt_level(const llvm::OptimizationLevel& level)
+{
+    switch(level.getSpeedupLevel())
+    {
+        case 0:
+            return llvm::CodeGenOpt::None;
+        case 1:
+            return llvm::CodeGenOpt::Less;
+        case 2:
+            return llvm::CodeGenOpt::Default;
+        default:
+            return llvm::CodeGenOpt::Aggressive;
+    }
+}
+
+std::unique_ptr<llvm::TargetMachine> create_target_machine(const llvm::OptimizationLevel& level, const TargetCpu& cpu, bool fast_math)
+{
+    // Target registration is not thread-safe, and modules create their
+    // target machines concurrently.
+    static std::once_flag initialized;
+    std::call_once(initialized, []
+    {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+
+    std::string target_triple = llvm::sys::getDefaultTargetTriple();
+    std::string error;
+
+    const llvm::Target* target = llvm::TargetRegistry::lookupTarget(target_triple, error);
+
+    if(!target)
+    {
+        throw std::runtime_error("Failed to find target '" + target_triple + "': " + error);
+    }
+
+    llvm::TargetOptions options;
+
+    if(fast_math)
+    {
+        set_fast_math_options(options);
+    }
+
+    std::string cpu_name = cpu.name.empty() ? "generic" : cpu.name;
+    std::unique_ptr<llvm::MCSubtargetInfo> subtarget(target->createMCSubtargetInfo(target_triple, "", ""));
+
+    if(!subtarget->isCPUStringValid(cpu_name))
+    {
+        throw std::runtime_error("Unknown CPU '" + cpu_name + "' for target '" + target_triple + "'.");
+    }
+
+    return std::unique_ptr<llvm::TargetMachine>(
+        target->createTargetMachine(target_triple, cpu_name, cpu.features, options, llvm::Reloc::PIC_, std::nullopt, get_codegen_opt_level(level)));
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// CPU to generate code for, as given by --march/--mcpu. An empty name keeps
+// each backend's default: generic x86-64 for executables, the host for
+// --run. "native" is resolved to the host CPU and its exact feature set.
+struct TargetCpu
+{
+    std::string name;
+    std::string features;
+};
+
+TargetCpu resolve_target_cpu(const std::string& cpu);
+
+void set_fast_math_options(llvm::TargetOptions& options);
+
+llvm::CodeGenOpt::Level get_codegen_opt_level(const llvm::OptimizationLevel& level);
+
+std::unique_ptr<llvm::TargetMachine> create_target_machine(const llvm::OptimizationLevel& level, const TargetCpu& cpu = {},
+                                                           bool fast_math = false);
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <llvm/IR/Constant.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Value.h>
+
+#include "../ast/ast.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+enum class ValueType : uint8_t
+{
+    UNDEFINED,
+    INTEGER,
+    FLOAT,
+    STRING,
+    BOOL,
+    // Fixed-size arrays; the length is part of the storage type.
+    INT_ARRAY,
+    FLOAT_ARRAY
+};
+
+struct Symbol
+{
+    ValueType type = ValueType::UNDEFINED;
+    bool is_const = false;
+
+    // Constants are bound to their value, mutable variables live in a
+    // stack slot of their current type. Arrays are bound to their storage.
+    llvm::Value* value = nullptr;
+    llvm::AllocaInst* slot = nullptr;
+
+    // Set when the symbol names a user-defined function.
+    const FunctionStatement* function_declaration = nullptr;
+    llvm::Function* function = nullptr;
+
+    // Function body that last looked the symbol up, 0 for the top level.
+    uint32_t scope = 0;
+
+    inline bool is_defined() const { return type != ValueType::UNDEFINED; }
+
+    inline void forget_variable()
+    {
+        type = ValueType::UNDEFINED;
+        is_const = false;
+        value = nullptr;
+        slot = nullptr;
+    }
+};
+
+// Flat table of the program's variables, indexed by the symbol ID the lexer
+// interned each identifier under.
+class SymbolTable
+{
+private:
+    std::vector<Symbol> m_symbols;
+
+    // Symbols as they were before the current function body first touched
+    // them.
+    std::vector<std::pair<uint32_t, Symbol>> m_undo_log;
+    uint32_t m_scope = 0;
+    uint32_t m_scope_count = 0;
+
+public:
+    inline void reserve(uint32_t symbol_count)
+    {
+        if (symbol_count > m_symbols.size())
+        {
+            m_symbols.resize(symbol_count);
+        }
+    }
+
+    inline Symbol& operator[](uint32_t symbol)
+    {
+        if (symbol >= m_symbols.size())
+        {
+            m_symbols.resize(symbol + 1);
+        }
+
+        Symbol& entry = m_symbols[symbol];
+
+        if (entry.scope != m_scope)
+        {
+            m_undo_log.emplace_back(symbol, entry);
+            entry.scope = m_scope;
+
+            if (!entry.is_const || !llvm::isa_and_nonnull<llvm::Constant>(entry.value))
+            {
+                entry.forget_variable();
+            }
+        }
+
+        return entry;
+    }
+
+    inline size_t size() const { return m_symbols.size(); }
+
+    // Scope of a function body: only constants with compile-time values
+    // stay visible, every other variable belongs to the enclosing code.
+    // Symbols are hidden the first time the body looks them up and put
+    // back from the undo log on the way out, so a function costs what its
+    // body touches rather than the size of the whole table.
+    inline void enter_function()
+    {
+        m_scope = ++m_scope_count;
+    }
+
+    inline void leave_function()
+    {
+        for (const auto& [symbol, saved] : m_undo_log)
+        {
+            m_symbols[symbol] = saved;
+        }
+
+        m_undo_log.clear();
+        m_scope = 0;
+    }
+};
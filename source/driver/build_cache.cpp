@@ -0,0 +1,244 @@
+#include "build_cache.hpp"
+#include "command_line.hpp"
+
+#include "../source_file/source_file.hpp"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/SHA256.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <system_error>
+
+#include <unistd.h>
+
+static std::string hash_bytes(std::string_view bytes)
+{
+    return llvm::toHex(llvm::SHA256::hash(llvm::arrayRefFromStringRef(llvm::StringRef(bytes.data(), bytes.size()))), true);
+}
+
+BuildCache::BuildCache(std::filesystem::path directory, uint64_t size_limit)
+    : m_directory(std::move(directory)), m_size_limit(size_limit)
+    {
+    }
+
+std::filesystem::path BuildCache::get_default_directory()
+{
+    if(const char* cache_home = std::getenv("XDG_CACHE_HOME"); cache_home && *cache_home)
+    {
+        return std::filesystem::path(cache_home) / "dust-lang";
+    }
+
+    if(const char* home = std::getenv("HOME"); home && *home)
+    {
+        return std::filesystem::path(home) / ".cache" / "dust-lang";
+    }
+
+    return std::filesystem::temp_directory_path() / "dust-lang-cache";
+}
+
+std::string BuildCache::get_compiler_identity()
+{
+    // A rebuilt compiler may generate different code for the same input, so
+    // its own size and modification time are part of the key too.
+    std::string identity = "dust-lang llvm-" LLVM_VERSION_STRING;
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size("/proc/self/exe", error);
+
+    if(!error)
+    {
+        auto modified = std::filesystem::last_write_time("/proc/self/exe", error);
+        identity += ' ';
+        identity += std::to_string(size);
+        identity += ' ';
+        identity += std::to_string(modified.time_since_epoch().count());
+    }
+
+    return identity;
+}
+
+std::string BuildCache::hash_file(const std::filesystem::path& path)
+{
+    try
+    {
+        SourceFile file(path.string());
+        return hash_bytes(file.get_source());
+    }
+    catch(const std::exception&)
+    {
+        return {};
+    }
+}
+
+std::string BuildCache::make_key(std::string_view source, const CommandLineOptions& options,
+                                 const llvm::TargetMachine& target_machine)
+{
+    std::string configuration = get_compiler_identity();
+    configuration += "\ntriple=" + target_machine.getTargetTriple().str();
+    configuration += "\ncpu=" + target_machine.getTargetCPU().str();
+    configuration += "\nfeatures=" + target_machine.getTargetFeatureString().str();
+    configuration += "\nspeedup=" + std::to_string(options.optimization_level.getSpeedupLevel());
+    configuration += "\nsize=" + std::to_string(options.optimization_level.getSizeLevel());
+    configuration += "\nfast-math=" + std::to_string(options.fast_math);
+    configuration += "\nlinker=" + std::to_string(static_cast<int>(options.linker));
+    configuration += "\nsource=" + hash_bytes(source);
+
+    return hash_bytes(configuration);
+}
+
+bool BuildCache::modules_unchanged(const std::filesystem::path& entry, const std::filesystem::path& source_directory) const
+{
+    std::ifstream modules(entry / "modules");
+
+    if(!modules.is_open())
+    {
+        return false;
+    }
+
+    std::string hash;
+    std::string path;
+
+    while(modules >> hash && std::getline(modules >> std::ws, path))
+    {
+        if(hash_file(source_directory / path) != hash)
+        {
+            return false;
+        }
+    }
+
+    return modules.eof();
+}
+
+bool BuildCache::restore(const std::string& key, const std::string& input_file, const std::string& output_file) const
+{
+    std::filesystem::path entry = m_directory / key;
+    std::filesystem::path source_directory = std::filesystem::path(input_file).parent_path();
+    std::error_code error;
+
+    if(source_directory.empty())
+    {
+        source_directory = ".";
+    }
+
+    if(!std::filesystem::exists(entry / "executable", error) || !modules_unchanged(entry, source_directory))
+    {
+        return false;
+    }
+
+    // Replace rather than overwrite, so a running copy of the old output is
+    // left alone.
+    std::filesystem::remove(output_file, error);
+
+    if(!std::filesystem::copy_file(entry / "executable", output_file, error))
+    {
+        return false;
+    }
+
+    std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), error);
+
+    return true;
+}
+
+void BuildCache::store(const std::string& key, const std::string& input_file, const std::vector<std::string>& module_paths,
+                       const std::string& output_file) const
+{
+    std::filesystem::path entry = m_directory / key;
+    std::filesystem::path source_directory = std::filesystem::path(input_file).parent_path();
+    std::error_code error;
+    std::string modules;
+
+    if(source_directory.empty())
+    {
+        source_directory = ".";
+    }
+
+    for(const std::string& path : module_paths)
+    {
+        std::string hash = hash_file(path);
+        std::filesystem::path relative = std::filesystem::relative(path, source_directory, error);
+
+        if(hash.empty() || error)
+        {
+            return;
+        }
+
+        modules += hash + " " + relative.string() + "\n";
+    }
+
+    // The entry is assembled under a private name and renamed into place, so
+    // concurrent builds never see half of one.
+    std::filesystem::path staging = m_directory / (key + ".tmp" + std::to_string(getpid()));
+    std::filesystem::remove_all(staging, error);
+
+    if(!std::filesystem::create_directories(staging, error)
+       || !std::filesystem::copy_file(output_file, staging / "executable", error))
+    {
+        std::filesystem::remove_all(staging, error);
+        return;
+    }
+
+    std::ofstream(staging / "modules") << modules;
+
+    std::filesystem::remove_all(entry, error);
+    std::filesystem::rename(staging, entry, error);
+
+    if(error)
+    {
+        std::filesystem::remove_all(staging, error);
+        return;
+    }
+
+    evict();
+}
+
+void BuildCache::evict() const
+{
+    struct Entry
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type last_used;
+        uint64_t size;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t total_size = 0;
+    std::error_code error;
+
+    for(const std::filesystem::directory_entry& directory : std::filesystem::directory_iterator(m_directory, error))
+    {
+        // Staging directories belong to builds still storing their entry.
+        if(!directory.is_directory(error) || directory.path().filename().string().find(".tmp") != std::string::npos)
+        {
+            continue;
+        }
+
+        Entry entry{directory.path(), directory.last_write_time(error), 0};
+
+        for(const std::filesystem::directory_entry& file : std::filesystem::directory_iterator(directory.path(), error))
+        {
+            uint64_t size = file.file_size(error);
+            entry.size += error ? 0 : size;
+        }
+
+        total_size += entry.size;
+        entries.push_back(std::move(entry));
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& left, const Entry& right)
+    {
+        return left.last_used < right.last_used;
+    });
+
+    for(const Entry& entry : entries)
+    {
+        if(total_size <= m_size_limit)
+        {
+            break;
+        }
+
+        std::filesystem::remove_all(entry.path, error);
+        total_size -= entry.size;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <llvm/Target/TargetMachine.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct CommandLineOptions;
+
+// On-disk cache of built executables, so rebuilding an unchanged program
+// skips code generation and linking altogether.
+//
+// Entries are keyed by a SHA-256 of the main file's bytes, the compiler
+// itself and every option that changes the output: target triple, CPU and
+// features, optimization level, --fast-math and the linker. Modules are
+// found by parsing, so each entry also records the modules it was built
+// from with their own hashes, and a lookup misses if any of them changed.
+//
+//   <cache>/<key>/executable
+//   <cache>/<key>/modules      "<sha256> <path relative to the main file>"
+//   <cache>/<key>.tmp<pid>/    an entry being assembled by process <pid>
+//
+// A hit refreshes the entry's modification time; storing evicts the least
+// recently used entries until the cache fits its size limit, leaving the
+// staging directories of other builds alone. Failing to
+// read or write the cache never fails a build, it only misses.
+class BuildCache
+{
+private:
+    std::filesystem::path m_directory;
+    uint64_t m_size_limit;
+
+    bool modules_unchanged(const std::filesystem::path& entry, const std::filesystem::path& source_directory) const;
+    void evict() const;
+
+    static std::string hash_file(const std::filesystem::path& path);
+    static std::string get_compiler_identity();
+
+public:
+    static constexpr uint64_t DEFAULT_SIZE_LIMIT = 256ull * 1024 * 1024;
+
+    explicit BuildCache(std::filesystem::path directory, uint64_t size_limit = DEFAULT_SIZE_LIMIT);
+
+    // $XDG_CACHE_HOME/dust-lang, or ~/.cache/dust-lang.
+    static std::filesystem::path get_default_directory();
+
+    static std::string make_key(std::string_view source, const CommandLineOptions& options,
+                                const llvm::TargetMachine& target_machine);
+
+    // Copies the cached executable to output_file, if there is one for key
+    // and the modules it was built from are unchanged.
+    bool restore(const std::string& key, const std::string& input_file, const std::string& output_file) const;
+
+    void store(const std::string& key, const std::string& input_file, const std::vector<std::string>& module_paths,
+               const std::string& output_file) const;
+};
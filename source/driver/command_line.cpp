@@ -0,0 +1,120 @@
+#include "command_line.hpp"
+
+#include <charconv>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+
+[[noreturn]] static void print_usage_and_exit()
+{
+    std::cerr << "[-] Incorrect usage." << std::endl;
+    std::cerr << "[-] Correct usage: ./dust-lang [options] [input.dust]" << std::endl;
+    std::cerr << "[-] Options:" << std::endl;
+    std::cerr << "[-]   -o <file>    Name of the produced executable (default: out)" << std::endl;
+    std::cerr << "[-]   -O<0-3>      Optimization level (default: -O0)" << std::endl;
+    std::cerr << "[-]   --lld        Link in-process with lld instead of the system clang" << std::endl;
+    std::cerr << "[-]   --run        JIT-compile and run the program, its exit() value becomes the exit code" << std::endl;
+    std::cerr << "[-]   --mcpu=<cpu> Generate code for the given CPU, 'native' for this machine (also --march)" << std::endl;
+    std::cerr << "[-]   --fast-math  Let floating-point math be reassociated, assuming no NaNs or infinities" << std::endl;
+    std::cerr << "[-]   --no-cache   Always rebuild, without reading or updating the build cache" << std::endl;
+    std::cerr << "[-]   --cache-dir=<dir> Build cache directory (default: $XDG_CACHE_HOME/dust-lang)" << std::endl;
+    std::cerr << "[-]   --cache-size=<MiB> Size the build cache is kept under (default: 256)" << std::endl;
+
+    exit(EXIT_FAILURE);
+}
+
+CommandLineOptions parse_command_line(int argc, char** argv)
+{
+    CommandLineOptions options;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string_view argument = argv[i];
+
+        if(argument == "-o")
+        {
+            if(++i >= argc)
+            {
+                print_usage_and_exit();
+            }
+            options.output_file = argv[i];
+        }
+        else if(argument == "-O0")
+        {
+            options.optimization_level = llvm::OptimizationLevel::O0;
+        }
+        else if(argument == "-O1")
+        {
+            options.optimization_level = llvm::OptimizationLevel::O1;
+        }
+        else if(argument == "-O2")
+        {
+            options.optimization_level = llvm::OptimizationLevel::O2;
+        }
+        else if(argument == "-O3")
+        {
+            options.optimization_level = llvm::OptimizationLevel::O3;
+        }
+        else if(argument == "--lld")
+        {
+            options.linker = Linker::LLD;
+        }
+        else if(argument == "--run")
+        {
+            options.run = true;
+        }
+        else if(argument.starts_with("--mcpu=") || argument.starts_with("--march="))
+        {
+            options.cpu = argument.substr(argument.find('=') + 1);
+
+            if(options.cpu.empty())
+            {
+                print_usage_and_exit();
+            }
+        }
+        else if(argument == "--fast-math")
+        {
+            options.fast_math = true;
+        }
+        else if(argument == "--no-cache")
+        {
+            options.use_cache = false;
+        }
+        else if(argument.starts_with("--cache-dir="))
+        {
+            options.cache_dir = argument.substr(argument.find('=') + 1);
+
+            if(options.cache_dir.empty())
+            {
+                print_usage_and_exit();
+            }
+        }
+        else if(argument.starts_with("--cache-size="))
+        {
+            std::string_view size = argument.substr(argument.find('=') + 1);
+            uint64_t megabytes = 0;
+            auto [end, error] = std::from_chars(size.data(), size.data() + size.size(), megabytes);
+
+            if(size.empty() || error != std::errc() || end != size.data() + size.size())
+            {
+                print_usage_and_exit();
+            }
+            options.cache_size_limit = megabytes * 1024 * 1024;
+        }
+        else if(!argument.empty() && argument[0] != '-' && options.input_file.empty())
+        {
+            options.input_file = argument;
+        }
+        else
+        {
+            print_usage_and_exit();
+        }
+    }
+
+    if(options.input_file.empty())
+    {
+        print_usage_and_exit();
+    }
+
+    return options;
+}
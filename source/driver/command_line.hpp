@@ -0,0 +1,27 @@
+#pragma once
+
+#include "../compiler/llvm_executable_builder.hpp"
+#include "build_cache.hpp"
+
+#include <llvm/Passes/OptimizationLevel.h>
+
+#include <cstdint>
+#include <string>
+
+struct CommandLineOptions
+{
+    std::string input_file;
+    std::string output_file = "out";
+    Linker linker = Linker::CLANG;
+    bool run = false;
+    // Empty for the backend default, "native" for the host.
+    std::string cpu;
+    bool fast_math = false;
+    bool use_cache = true;
+    // Empty for BuildCache's default directory.
+    std::string cache_dir;
+    uint64_t cache_size_limit = BuildCache::DEFAULT_SIZE_LIMIT;
+    llvm::OptimizationLevel optimization_level = llvm::OptimizationLevel::O0;
+};
+
+CommandLineOptions parse_command_line(int argc, char** argv);
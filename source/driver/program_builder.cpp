@@ -0,0 +1,205 @@
+#include "program_builder.hpp"
+
+#include "../parser/parser.hpp"
+#include "../token/token_buffer/token_buffer.hpp"
+
+#include <llvm/Support/Threading.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+
+ProgramBuilder::ProgramBuilder(const llvm::OptimizationLevel& optimization_level, TargetCpu cpu, bool fast_math)
+    : m_optimization_level(optimization_level), m_cpu(std::move(cpu)), m_fast_math(fast_math)
+    {
+    }
+
+std::unique_ptr<LLVMCompiler> ProgramBuilder::build(const std::string& path)
+{
+    SourceModule* main_module = add_module("dust_prog", path);
+    main_module->is_main = true;
+    parse_module(*main_module);
+
+    std::vector<SourceModule*> discovered;
+    resolve_uses(*main_module, discovered);
+
+    if(discovered.empty())
+    {
+        main_module->compiler = std::make_unique<LLVMCompiler>(main_module->name, m_fast_math);
+        main_module->compiler->generate(main_module->program);
+
+        return std::move(main_module->compiler);
+    }
+
+    llvm::ThreadPool pool(llvm::hardware_concurrency());
+    load_modules(pool);
+
+    for(const std::unique_ptr<SourceModule>& module : m_modules)
+    {
+        pool.async([this, &module] { compile_module(*module); });
+    }
+
+    pool.wait();
+
+    for(size_t i = 1; i < m_modules.size(); ++i)
+    {
+        SourceModule& module = *m_modules[i];
+        main_module->compiler->link_module(llvm::StringRef(module.bitcode.data(), module.bitcode.size()), module.name);
+        module.bitcode.clear();
+    }
+
+    return std::move(main_module->compiler);
+}
+
+std::vector<std::string> ProgramBuilder::get_module_paths() const
+{
+    std::vector<std::string> paths;
+
+    for(const std::unique_ptr<SourceModule>& module : m_modules)
+    {
+        if(!module->is_main)
+        {
+            paths.push_back(module->path);
+        }
+    }
+
+    return paths;
+}
+
+ProgramBuilder::SourceModule* ProgramBuilder::add_module(const std::string& name, const std::string& path)
+{
+    std::unique_ptr<SourceModule> module = std::make_unique<SourceModule>();
+    module->name = name;
+    module->path = path;
+
+    SourceModule* added = module.get();
+    m_modules_by_path.emplace(std::filesystem::weakly_canonical(path).string(), added);
+    m_modules.push_back(std::move(module));
+
+    return added;
+}
+
+// Breadth first: every module found by the previous round is parsed
+// concurrently, then its `use` statements name the next round.
+void ProgramBuilder::load_modules(llvm::ThreadPool& pool)
+{
+    std::vector<SourceModule*> round;
+    std::vector<SourceModule*> discovered;
+
+    for(size_t i = 1; i < m_modules.size(); ++i)
+    {
+        round.push_back(m_modules[i].get());
+    }
+
+    while(!round.empty())
+    {
+        for(SourceModule* module : round)
+        {
+            pool.async([module] { parse_module(*module); });
+        }
+
+        pool.wait();
+
+        for(SourceModule* module : round)
+        {
+            resolve_uses(*module, discovered);
+        }
+
+        round = std::move(discovered);
+        discovered.clear();
+    }
+}
+
+void ProgramBuilder::parse_module(SourceModule& module)
+{
+    module.source = std::make_unique<SourceFile>(module.path);
+    module.lexer = std::make_unique<Lexer>(module.source->get_source());
+    module.program = Parser(TokenBuffer(*module.lexer), module.arena).parse();
+}
+
+void ProgramBuilder::resolve_uses(SourceModule& module, std::vector<SourceModule*>& discovered)
+{
+    std::filesystem::path directory = std::filesystem::path(module.path).parent_path();
+
+    for(const Statement* statement = module.program.statements.first; statement != nullptr; statement = statement->next)
+    {
+        if(statement->kind != StatementKind::USE_MODULE)
+        {
+            continue;
+        }
+
+        std::string name(static_cast<const UseModuleStatement*>(statement)->name);
+        std::string path = (directory / (name + ".dust")).string();
+
+        if(!std::filesystem::exists(path))
+        {
+            std::cerr << "Error: Module '" << name << "' not found, expected it at '" << path << "'." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        auto found = m_modules_by_path.find(std::filesystem::weakly_canonical(path).string());
+        SourceModule* used = found != m_modules_by_path.end() ? found->second : nullptr;
+
+        if(!used)
+        {
+            used = add_module(name, path);
+            discovered.push_back(used);
+        }
+        else if(used->is_main)
+        {
+            std::cerr << "Error: Module '" << module.name << "' can`t use the main program." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        module.uses.push_back(used);
+    }
+}
+
+// Runs on a pool thread. Everything it touches is owned by this module,
+// apart from the ASTs of the modules it uses, which are only read.
+void ProgramBuilder::compile_module(SourceModule& module)
+{
+    module.compiler = std::make_unique<LLVMCompiler>(module.name, m_fast_math);
+    module.compiler->share_runtime();
+
+    // Only functions whose names this module mentions can be called from it.
+    for(const SourceModule* used : module.uses)
+    {
+        for(const Statement* statement = used->program.statements.first; statement != nullptr; statement = statement->next)
+        {
+            if(statement->kind != StatementKind::FUNCTION)
+            {
+                continue;
+            }
+
+            const FunctionStatement* function = static_cast<const FunctionStatement*>(statement);
+            std::optional<uint32_t> symbol = module.lexer->get_interner().find(function->name);
+
+            if(symbol)
+            {
+                module.compiler->import_function(function, *symbol, used->name);
+            }
+        }
+    }
+
+    if(module.is_main)
+    {
+        module.compiler->generate(module.program);
+    }
+    else
+    {
+        module.compiler->generate_module(module.program);
+    }
+
+    module.compiler->verify_module();
+
+    std::unique_ptr<llvm::TargetMachine> target_machine = create_target_machine(m_optimization_level, m_cpu, m_fast_math);
+    module.compiler->optimize_before_link(m_optimization_level, *target_machine);
+
+    if(!module.is_main)
+    {
+        module.bitcode = module.compiler->write_bitcode();
+        module.compiler.reset();
+    }
+}
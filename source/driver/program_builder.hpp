@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../ast/arena.hpp"
+#include "../ast/ast.hpp"
+#include "../compiler/llvm_compiler.hpp"
+#include "../compiler/llvm_target.hpp"
+#include "../lexer/lexer.hpp"
+#include "../source_file/source_file.hpp"
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Support/ThreadPool.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Compiles a program together with the modules it uses. `use foo;` loads
+// foo.dust from the directory of the file that says it, and makes the
+// functions of foo callable by name.
+//
+// Modules are parsed, then compiled, on a thread pool. Each one gets its
+// own LLVMCompiler and LLVMContext, runs the pre-link half of the
+// optimization pipeline on its thread, and reaches the main program as
+// bitcode, where llvm::Linker combines them. A single-file program is
+// compiled on the calling thread exactly as before.
+class ProgramBuilder
+{
+private:
+    struct SourceModule
+    {
+        std::string name;
+        std::string path;
+        bool is_main = false;
+
+        std::unique_ptr<SourceFile> source;
+        std::unique_ptr<Lexer> lexer;
+        Arena arena;
+        Program program;
+
+        std::vector<SourceModule*> uses;
+
+        std::unique_ptr<LLVMCompiler> compiler;
+        llvm::SmallVector<char, 0> bitcode;
+    };
+
+    llvm::OptimizationLevel m_optimization_level;
+    TargetCpu m_cpu;
+    bool m_fast_math;
+
+    // The main program comes first.
+    std::vector<std::unique_ptr<SourceModule>> m_modules;
+    std::unordered_map<std::string, SourceModule*> m_modules_by_path;
+
+    SourceModule* add_module(const std::string& name, const std::string& path);
+    void load_modules(llvm::ThreadPool& pool);
+    void resolve_uses(SourceModule& module, std::vector<SourceModule*>& discovered);
+    void compile_module(SourceModule& module);
+
+    static void parse_module(SourceModule& module);
+
+public:
+    ProgramBuilder(const llvm::OptimizationLevel& optimization_level, TargetCpu cpu, bool fast_math);
+
+    // The main program's compiler, holding the whole linked program.
+    std::unique_ptr<LLVMCompiler> build(const std::string& path);
+
+    // Paths of the modules the last build used, the main program excluded.
+    std::vector<std::string> get_module_paths() const;
+};
@@ -0,0 +1,193 @@
+#include "char_scanner.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DUST_SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+size_t scalar_skip_whitespace(const char* data, size_t size, size_t pos)
+{
+    while (pos < size && is_space(data[pos]))
+        ++pos;
+    return pos;
+}
+
+size_t scalar_identifier_end(const char* data, size_t size, size_t pos)
+{
+    while (pos < size && is_alpha(data[pos]))
+        ++pos;
+    return pos;
+}
+
+size_t scalar_digits_end(const char* data, size_t size, size_t pos)
+{
+    while (pos < size && is_digit(data[pos]))
+        ++pos;
+    return pos;
+}
+
+size_t scalar_find_quote(const char* data, size_t size, size_t pos)
+{
+    while (pos < size && data[pos] != '"' && data[pos] != '\0')
+        ++pos;
+    return pos;
+}
+
+#ifdef DUST_SCANNER_X86
+
+// Signed byte compares are enough for every class below: bytes >= 0x80 are
+// negative and therefore never fall into an ASCII range.
+
+inline __m128i sse2_in_range(__m128i bytes, char low, char high)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(static_cast<char>(low - 1))),
+                         _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(high + 1))));
+}
+
+inline __m128i sse2_space_mask(__m128i bytes)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')), sse2_in_range(bytes, '\t', '\r'));
+}
+
+inline __m128i sse2_alpha_mask(__m128i bytes)
+{
+    return sse2_in_range(_mm_or_si128(bytes, _mm_set1_epi8(0x20)), 'a', 'z');
+}
+
+inline __m128i sse2_digit_mask(__m128i bytes)
+{
+    return sse2_in_range(bytes, '0', '9');
+}
+
+inline __m128i sse2_quote_mask(__m128i bytes)
+{
+    return _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')), _mm_cmpeq_epi8(bytes, _mm_setzero_si128()));
+}
+
+// Advances 16 bytes at a time while every byte is inside the class
+// (or, with Stop = true, while no byte is), then finishes with `tail`.
+template <__m128i (*Mask)(__m128i), bool Stop>
+size_t sse2_scan(const char* data, size_t size, size_t pos, size_t (*tail)(const char*, size_t, size_t))
+{
+    while (pos + 16 <= size)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(Mask(bytes)));
+
+        if (!Stop)
+            mask = ~mask & 0xFFFFu;
+
+        if (mask != 0)
+            return pos + __builtin_ctz(mask);
+
+        pos += 16;
+    }
+
+    return tail(data, size, pos);
+}
+
+size_t sse2_skip_whitespace(const char* data, size_t size, size_t pos) { return sse2_scan<sse2_space_mask, false>(data, size, pos, scalar_skip_whitespace); }
+size_t sse2_identifier_end(const char* data, size_t size, size_t pos) { return sse2_scan<sse2_alpha_mask, false>(data, size, pos, scalar_identifier_end); }
+size_t sse2_digits_end(const char* data, size_t size, size_t pos) { return sse2_scan<sse2_digit_mask, false>(data, size, pos, scalar_digits_end); }
+size_t sse2_find_quote(const char* data, size_t size, size_t pos) { return sse2_scan<sse2_quote_mask, true>(data, size, pos, scalar_find_quote); }
+
+#define DUST_AVX2 __attribute__((target("avx2")))
+
+DUST_AVX2 inline __m256i avx2_in_range(__m256i bytes, char low, char high)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(static_cast<char>(low - 1))),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(high + 1)), bytes));
+}
+
+DUST_AVX2 inline __m256i avx2_space_mask(__m256i bytes)
+{
+    return _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')), avx2_in_range(bytes, '\t', '\r'));
+}
+
+DUST_AVX2 inline __m256i avx2_alpha_mask(__m256i bytes)
+{
+    return avx2_in_range(_mm256_or_si256(bytes, _mm256_set1_epi8(0x20)), 'a', 'z');
+}
+
+DUST_AVX2 inline __m256i avx2_digit_mask(__m256i bytes)
+{
+    return avx2_in_range(bytes, '0', '9');
+}
+
+DUST_AVX2 inline __m256i avx2_quote_mask(__m256i bytes)
+{
+    return _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256()));
+}
+
+template <__m256i (*Mask)(__m256i), bool Stop>
+DUST_AVX2 size_t avx2_scan(const char* data, size_t size, size_t pos, size_t (*tail)(const char*, size_t, size_t))
+{
+    while (pos + 32 <= size)
+    {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(Mask(bytes)));
+
+        if (!Stop)
+            mask = ~mask;
+
+        if (mask != 0)
+            return pos + __builtin_ctz(mask);
+
+        pos += 32;
+    }
+
+    return tail(data, size, pos);
+}
+
+DUST_AVX2 size_t avx2_skip_whitespace(const char* data, size_t size, size_t pos) { return avx2_scan<avx2_space_mask, false>(data, size, pos, sse2_skip_whitespace); }
+DUST_AVX2 size_t avx2_identifier_end(const char* data, size_t size, size_t pos) { return avx2_scan<avx2_alpha_mask, false>(data, size, pos, sse2_identifier_end); }
+DUST_AVX2 size_t avx2_digits_end(const char* data, size_t size, size_t pos) { return avx2_scan<avx2_digit_mask, false>(data, size, pos, sse2_digits_end); }
+DUST_AVX2 size_t avx2_find_quote(const char* data, size_t size, size_t pos) { return avx2_scan<avx2_quote_mask, true>(data, size, pos, sse2_find_quote); }
+
+#undef DUST_AVX2
+
+#endif
+
+const CharScanner SCALAR_SCANNER = { "scalar", scalar_skip_whitespace, scalar_identifier_end, scalar_digits_end, scalar_find_quote };
+
+#ifdef DUST_SCANNER_X86
+const CharScanner SSE2_SCANNER = { "sse2", sse2_skip_whitespace, sse2_identifier_end, sse2_digits_end, sse2_find_quote };
+const CharScanner AVX2_SCANNER = { "avx2", avx2_skip_whitespace, avx2_identifier_end, avx2_digits_end, avx2_find_quote };
+#endif
+
+}
+
+const CharScanner* find_char_scanner(std::string_view name)
+{
+    if (name == SCALAR_SCANNER.name)
+        return &SCALAR_SCANNER;
+
+#ifdef DUST_SCANNER_X86
+    if (name == SSE2_SCANNER.name)
+        return &SSE2_SCANNER;
+
+    if (name == AVX2_SCANNER.name && __builtin_cpu_supports("avx2"))
+        return &AVX2_SCANNER;
+#endif
+
+    return nullptr;
+}
+
+const CharScanner& get_char_scanner()
+{
+    static const CharScanner& scanner = []() -> const CharScanner&
+    {
+        for (std::string_view name : { "avx2", "sse2" })
+        {
+            if (const CharScanner* candidate = find_char_scanner(name))
+                return *candidate;
+        }
+
+        return SCALAR_SCANNER;
+    }();
+
+    return scanner;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// ASCII character classes used by the lexer. Unlike <cctype> these never
+// consult the locale, and bytes >= 0x80 belong to no class.
+enum CharClass : uint8_t
+{
+    CHAR_SPACE = 1 << 0,
+    CHAR_ALPHA = 1 << 1,
+    CHAR_DIGIT = 1 << 2
+};
+
+constexpr std::array<uint8_t, 256> build_char_classes()
+{
+    std::array<uint8_t, 256> classes = {};
+
+    for (int c = 0; c < 256; ++c)
+    {
+        if (c == ' ' || (c >= '\t' && c <= '\r'))
+            classes[c] |= CHAR_SPACE;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+            classes[c] |= CHAR_ALPHA;
+        if (c >= '0' && c <= '9')
+            classes[c] |= CHAR_DIGIT;
+    }
+
+    return classes;
+}
+
+inline constexpr std::array<uint8_t, 256> CHAR_CLASSES = build_char_classes();
+
+inline bool is_space(char c) { return CHAR_CLASSES[static_cast<unsigned char>(c)] & CHAR_SPACE; }
+inline bool is_alpha(char c) { return CHAR_CLASSES[static_cast<unsigned char>(c)] & CHAR_ALPHA; }
+inline bool is_digit(char c) { return CHAR_CLASSES[static_cast<unsigned char>(c)] & CHAR_DIGIT; }
+
+// Run scanners used by the lexer. Each function returns the first position
+// at or after `pos` that ends the run (or `size` if the run reaches the end):
+//   skip_whitespace - first non-whitespace byte
+//   identifier_end  - first non-letter byte
+//   digits_end      - first non-digit byte
+//   find_quote      - first '"' or '\0' byte
+// The vectorized implementations are picked at runtime from what the CPU
+// supports, with a scalar fallback everywhere else.
+struct CharScanner
+{
+    const char* name;
+
+    size_t (*skip_whitespace)(const char* data, size_t size, size_t pos);
+    size_t (*identifier_end)(const char* data, size_t size, size_t pos);
+    size_t (*digits_end)(const char* data, size_t size, size_t pos);
+    size_t (*find_quote)(const char* data, size_t size, size_t pos);
+};
+
+// Best scanner for the running CPU.
+const CharScanner& get_char_scanner();
+
+// Scanner by name ("scalar", "sse2", "avx2"), or nullptr if it is not
+// available on the running CPU.
+const CharScanner* find_char_scanner(std::string_view name);
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../token/token_type.hpp"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Perfect hash over the keywords declared in token_type.hpp. The seed is
+// searched at compile time so that every keyword gets its own slot, which
+// makes a lookup one hash and one string compare regardless of how many
+// keywords the language has.
+
+struct KeywordSlot
+{
+    std::string_view spelling;
+    TokenType type;
+};
+
+inline constexpr size_t KEYWORD_TABLE_BITS = 6;
+inline constexpr size_t KEYWORD_TABLE_SIZE = size_t(1) << KEYWORD_TABLE_BITS;
+
+constexpr uint32_t keyword_hash(std::string_view word, uint32_t seed)
+{
+    uint32_t key = static_cast<uint32_t>(static_cast<unsigned char>(word.front())) << 16
+                 | static_cast<uint32_t>(static_cast<unsigned char>(word.back())) << 8
+                 | static_cast<uint32_t>(word.size() & 0xff);
+
+    return (key * seed) >> (32 - KEYWORD_TABLE_BITS);
+}
+
+constexpr bool is_perfect_keyword_seed(uint32_t seed)
+{
+    std::array<bool, KEYWORD_TABLE_SIZE> used = {};
+
+    for (const TokenTypeInfo& info : token_type_infos)
+    {
+        if (info.keyword.empty())
+            continue;
+
+        uint32_t slot = keyword_hash(info.keyword, seed);
+
+        if (used[slot])
+            return false;
+
+        used[slot] = true;
+    }
+
+    return true;
+}
+
+constexpr uint32_t find_keyword_seed()
+{
+    for (uint32_t seed = 0x9E3779B1u; seed < 0x9E3779B1u + 0x20000u; seed += 2)
+    {
+        if (is_perfect_keyword_seed(seed))
+            return seed;
+    }
+
+    return 0;
+}
+
+inline constexpr uint32_t KEYWORD_SEED = find_keyword_seed();
+
+static_assert(KEYWORD_SEED != 0, "No perfect hash seed for the keyword set, grow KEYWORD_TABLE_BITS.");
+
+constexpr std::array<KeywordSlot, KEYWORD_TABLE_SIZE> build_keyword_table()
+{
+    std::array<KeywordSlot, KEYWORD_TABLE_SIZE> table = {};
+
+    for (const TokenTypeInfo& info : token_type_infos)
+    {
+        if (!info.keyword.empty())
+            table[keyword_hash(info.keyword, KEYWORD_SEED)] = { info.keyword, info.type };
+    }
+
+    return table;
+}
+
+inline constexpr std::array<KeywordSlot, KEYWORD_TABLE_SIZE> KEYWORD_TABLE = build_keyword_table();
+
+inline std::optional<TokenType> lookup_keyword(std::string_view word)
+{
+    const KeywordSlot& slot = KEYWORD_TABLE[keyword_hash(word, KEYWORD_SEED)];
+
+    if (slot.spelling.empty() || slot.spelling != word)
+        return std::nullopt;
+
+    return slot.type;
+}
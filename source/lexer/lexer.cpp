@@ -1,163 +1,216 @@
 #include "lexer.hpp"
+#include "keyword_table.hpp"
 
-#include <cctype>
+#include <charconv>
+#include <cstdint>
 #include <cstdlib>
+#include <limits>
+#include <optional>
 #include <stdexcept>
 #include <vector>
 
-Lexer::Lexer(std::string source)
-    : m_source(source), m_pos(0)
+Lexer::Lexer(std::string_view source, const CharScanner& scanner)
+    : m_source(source), m_pos(0), m_scanner(&scanner)
 {
+    if (m_source.size() > std::numeric_limits<uint32_t>::max())
+    {
+        std::cerr << "Lexing error. Source files larger than 4 GiB are not supported." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
     if (!m_source.empty())
         m_current = m_source[0];
+    else
+        m_current = '\0';
 }
 
-void Lexer::move_next()
-{
-    ++m_pos;
+void Lexer::move_next() { advance_to(m_pos + 1); }
 
-    if (m_pos > m_source.size() - 1)
-        m_current = '\0';
-    else
-        m_current = m_source[m_pos];
+void Lexer::advance_to(size_t pos)
+{
+    m_pos = pos;
+    m_current = m_pos < m_source.size() ? m_source[m_pos] : '\0';
 }
 
-std::vector<Token> Lexer::tokenize()
+std::string_view Lexer::slice_from(size_t start) const { return m_source.substr(start, m_pos - start); }
+
+Token Lexer::next_token()
 {
-    std::vector<Token> tokens;
+    if (m_string_state == StringState::LITERAL)
+    {
+        size_t literal_start = m_pos;
+
+        advance_to(m_scanner->find_quote(m_source.data(), m_source.size(), m_pos));
+
+        if(m_current != '\"')
+        {
+            std::cerr << "Lexing error. Closing quote not found." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        m_string_state = StringState::CLOSING_QUOTE;
+
+        std::string_view string_literal = slice_from(literal_start);
+        return Token(TokenType::STRING_LITERAL, string_literal, m_interner.intern(string_literal));
+    }
+
+    if (m_string_state == StringState::CLOSING_QUOTE)
+    {
+        size_t quote_start = m_pos;
+        move_next();
+
+        m_string_state = StringState::NONE;
+        return Token(TokenType::QOUTE, slice_from(quote_start));
+    }
 
     while (m_current != '\0')
     {
-        if (!std::isspace(m_current))
+        if (!is_space(m_current))
         {
-            if (std::isalpha(m_current))
+            size_t start = m_pos;
+
+            if (is_alpha(m_current))
             {
-                std::string keyword;
+                advance_to(m_scanner->identifier_end(m_source.data(), m_source.size(), m_pos));
 
-                while (std::isalpha(m_current))
-                {
-                    keyword.push_back(m_current);
-                    move_next();
-                }
+                std::string_view keyword = slice_from(start);
 
-                if (keyword == "exit")
-                {
-                    tokens.emplace_back(TokenType::EXIT, std::move(keyword));
-                }
-                else if (keyword == "writeln")
-                {
-                    tokens.emplace_back(TokenType::WRITELN, std::move(keyword));
-                }
-                else if (keyword == "mut")
-                {
-                    tokens.emplace_back(TokenType::MUT, std::move(keyword));
-                }
-                else if (keyword == "const")
-                {
-                    tokens.emplace_back(TokenType::CONST, std::move(keyword));
-                }
-                else if (keyword == "true")
-                {
-                    tokens.emplace_back(TokenType::TRUE, std::move(keyword));
-                }
-                else if (keyword == "false")
+                std::optional<TokenType> keyword_type = lookup_keyword(keyword);
+
+                if (!keyword_type)
                 {
-                    tokens.emplace_back(TokenType::FALSE, std::move(keyword));
-                }
-                else if (keyword == "use") {
-                move_next();
-                std::string next_keyword;
-                while (std::isalpha(m_current)) {
-                    next_keyword.push_back(m_current);
-                    move_next();
+                    return Token(TokenType::IDENTIFIER, keyword, m_interner.intern(keyword));
                 }
-                if (next_keyword == "io") {
-                    tokens.emplace_back(TokenType::USE_IO, "use io");
-                } else {
-                    tokens.emplace_back(TokenType::IDENTIFIER, std::move(keyword));
-                }
-            }
                 else
                 {
-                    tokens.emplace_back(TokenType::IDENTIFIER, std::move(keyword));
+                    return Token(*keyword_type, keyword);
                 }
             }
-            else if (std::isdigit(m_current) || m_current == '.')
+            else if (is_digit(m_current) || m_current == '.')
             {
-                std::string initial_digit;
                 bool hasDecimal = false;
 
-                while(std::isdigit(m_current) || (!hasDecimal && m_current == '.'))
+                advance_to(m_scanner->digits_end(m_source.data(), m_source.size(), m_pos));
+
+                if (m_current == '.')
                 {
-                    if (m_current == '.')
-                    {
-                        hasDecimal = true;
-                    }
-                    initial_digit.push_back(m_current);
-                    move_next();
+                    hasDecimal = true;
+                    advance_to(m_scanner->digits_end(m_source.data(), m_source.size(), m_pos + 1));
                 }
 
+                std::string_view initial_digit = slice_from(start);
+
                 if (hasDecimal)
                 {
-                    tokens.emplace_back(TokenType::FLOAT_LITERAL, std::move(initial_digit));
+                    double number = 0.0;
+                    std::from_chars_result result = std::from_chars(initial_digit.data(), initial_digit.data() + initial_digit.size(), number);
+
+                    if (result.ec != std::errc())
+                    {
+                        std::cerr << "Lexing error. Invalid number literal: " << initial_digit << std::endl;
+                        exit(EXIT_FAILURE);
+                    }
+
+                    return Token(TokenType::FLOAT_LITERAL, initial_digit, number);
                 }
                 else
                 {
-                    tokens.emplace_back(TokenType::INT_LITERAL, std::move(initial_digit));
+                    // Kept as an exact int64; a double would round anything
+                    // above 2^53.
+                    int64_t integer = 0;
+                    std::from_chars_result result = std::from_chars(initial_digit.data(), initial_digit.data() + initial_digit.size(), integer);
+
+                    if (result.ec != std::errc() || result.ptr != initial_digit.data() + initial_digit.size())
+                    {
+                        std::cerr << "Lexing error. Integer literal '" << initial_digit << "' is out of range." << std::endl;
+                        exit(EXIT_FAILURE);
+                    }
+
+                    return Token(TokenType::INT_LITERAL, initial_digit, integer);
                 }
             }
 
             else if(m_current == ';')
             {
-                tokens.emplace_back(TokenType::SEMICOLON, ";");
                 move_next();
+                return Token(TokenType::SEMICOLON, slice_from(start));
             }
 
             else if(m_current == '(')
             {
-                tokens.emplace_back(TokenType::LPAREN, "(");
                 move_next();
+                return Token(TokenType::LPAREN, slice_from(start));
             }
 
             else if (m_current == '+')
             {
-                tokens.emplace_back(TokenType::PLUS, "+");
                 move_next();
+                return Token(TokenType::PLUS, slice_from(start));
             }
             else if (m_current == '-')
             {
-                tokens.emplace_back(TokenType::MINUS, "-");
                 move_next();
+                return Token(TokenType::MINUS, slice_from(start));
             }
             else if (m_current == '*')
             {
-                tokens.emplace_back(TokenType::MUL, "*");
                 move_next();
+                return Token(TokenType::MUL, slice_from(start));
             }
             else if (m_current == '/')
             {
-                tokens.emplace_back(TokenType::DIV, "/");
                 move_next();
+                return Token(TokenType::DIV, slice_from(start));
             }
             else if(m_current == '<')
             {
-                tokens.emplace_back(TokenType::LESS, "<");
                 move_next();
+                return Token(TokenType::LESS, slice_from(start));
             }
             else if(m_current == '>')
             {
-                tokens.emplace_back(TokenType::MORE, ">");
                 move_next();
+                return Token(TokenType::MORE, slice_from(start));
             }
             else if(m_current == '?')
             {
-                tokens.emplace_back(TokenType::CHECK, "?");
                 move_next();
+                return Token(TokenType::CHECK, slice_from(start));
             }
             else if(m_current == ')')
             {
-                tokens.emplace_back(TokenType::RPAREN, ")");
                 move_next();
+                return Token(TokenType::RPAREN, slice_from(start));
+            }
+            else if(m_current == '{')
+            {
+                move_next();
+                return Token(TokenType::LBRACE, slice_from(start));
+            }
+            else if(m_current == '}')
+            {
+                move_next();
+                return Token(TokenType::RBRACE, slice_from(start));
+            }
+            else if(m_current == ',')
+            {
+                move_next();
+                return Token(TokenType::COMMA, slice_from(start));
+            }
+            else if(m_current == ':')
+            {
+                move_next();
+                return Token(TokenType::COLON, slice_from(start));
+            }
+            else if(m_current == '[')
+            {
+                move_next();
+                return Token(TokenType::LBRACKET, slice_from(start));
+            }
+            else if(m_current == ']')
+            {
+                move_next();
+                return Token(TokenType::RBRACKET, slice_from(start));
             }
 
             else if(m_current == '=')
@@ -165,12 +218,12 @@ std::vector<Token> Lexer::tokenize()
                 move_next();
                 if(m_current == '=')
                 {
-                    tokens.emplace_back(TokenType::EQUAL, "==");
                     move_next();
+                    return Token(TokenType::EQUAL, slice_from(start));
                 }
                 else
                 {
-                    tokens.emplace_back(TokenType::ASSIGN, "=");
+                    return Token(TokenType::ASSIGN, slice_from(start));
                 }
             }
 
@@ -179,32 +232,17 @@ std::vector<Token> Lexer::tokenize()
                 move_next();
                 if(m_current == '=')
                 {
-                    tokens.emplace_back(TokenType::NOT_EQUAL, "!=");
                     move_next();
+                    return Token(TokenType::NOT_EQUAL, slice_from(start));
                 }
             }
 
             else if(m_current == '"')
             {
-                tokens.emplace_back(TokenType::QOUTE, "\"");
                 move_next();
 
-                std::string string_literal = "";
-
-                while(m_current != '\"' && m_current != '\0')
-                {
-                    string_literal.push_back(m_current);
-                    move_next();
-                }
-                if(m_current != '\"')
-                {
-                    std::cerr << "Lexing error. Closing quote not found." << std::endl;
-                    exit(EXIT_FAILURE);
-                }
-                tokens.emplace_back(TokenType::STRING_LITERAL, std::move(string_literal));
-                tokens.emplace_back(TokenType::QOUTE, "\"");
-
-                move_next();
+                m_string_state = StringState::LITERAL;
+                return Token(TokenType::QOUTE, slice_from(start));
             }
             else
             {
@@ -214,9 +252,26 @@ std::vector<Token> Lexer::tokenize()
         }
         else
         {
-            move_next();
+            advance_to(m_scanner->skip_whitespace(m_source.data(), m_source.size(), m_pos));
         }
     }
 
+    return Token(TokenType::END_OF_FILE, m_source.substr(m_source.size()));
+}
+
+TokenStream Lexer::tokenize()
+{
+    TokenStream tokens(m_source);
+
+    // Tokens average well over four bytes of source, so the stream is
+    // written without regrowing, and without faulting in the pages of
+    // every intermediate buffer.
+    tokens.reserve(m_source.size() / 4);
+
+    for (Token token = next_token(); token.get_type() != TokenType::END_OF_FILE; token = next_token())
+    {
+        tokens.push(token);
+    }
+
     return tokens;
 }
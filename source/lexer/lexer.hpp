@@ -1,21 +1,45 @@
 #pragma once
 
+#include "char_scanner.hpp"
 #include "../token/token.hpp"
+#include "../token/string_interner.hpp"
+#include "../token/token_stream/token_stream.hpp"
 
+#include <string_view>
 #include <vector>
 
 class Lexer
 {
 private:
-    const std::string m_source;
+    const std::string_view m_source;
     size_t m_pos = 0;
     char m_current;
 
+    enum class StringState
+    {
+        NONE,
+        LITERAL,
+        CLOSING_QUOTE
+    };
+
+    const CharScanner* m_scanner;
+    StringState m_string_state = StringState::NONE;
+    StringInterner m_interner;
+
     void move_next();
+    void advance_to(size_t pos);
+    std::string_view slice_from(size_t start) const;
 public:
-    explicit Lexer(std::string source);
+    explicit Lexer(std::string_view source, const CharScanner& scanner = get_char_scanner());
+
+    inline std::string_view get_source() const { return m_source; }
+    inline const StringInterner& get_interner() const { return m_interner; }
 
-    inline std::string get_source() { return m_source; }
+    // Lexes and returns the next token, or END_OF_FILE once the source is
+    // exhausted. Tokens are not retained. Only the interner grows, by one
+    // entry per distinct identifier or string literal, so a caller pulling
+    // tokens one by one needs memory for those, not for every token.
+    Token next_token();
 
-    std::vector<Token> tokenize();
-};
\ No newline at end of file
+    TokenStream tokenize();
+};
@@ -0,0 +1,559 @@
+#include "parser.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+Parser::Parser(TokenBuffer tokens_buffer, Arena& arena)
+    : m_tokens_buffer(std::move(tokens_buffer)), m_arena(arena)
+    {
+    }
+
+TokenType Parser::current_type() const { return m_tokens_buffer.current_type(); }
+std::string_view Parser::current_value() const { return m_tokens_buffer.current_value(); }
+
+void Parser::check_token_type(TokenType expected_type, std::string_view error_message) const
+{
+    if(current_type() != expected_type)
+    {
+        std::cerr << "Syntax error. " << error_message << std::endl;
+
+        exit(EXIT_FAILURE);
+    }
+}
+
+void Parser::expect(TokenType expected_type, std::string_view error_message)
+{
+    check_token_type(expected_type, error_message);
+    m_tokens_buffer.advance();
+}
+
+// Symbol ID of the current identifier.
+uint32_t Parser::take_symbol()
+{
+    uint32_t symbol = m_tokens_buffer.current().get_symbol();
+
+    if(symbol >= m_symbol_count)
+    {
+        m_symbol_count = symbol + 1;
+    }
+
+    return symbol;
+}
+
+Program Parser::parse()
+{
+    Program program;
+
+    while(current_type() != TokenType::END_OF_FILE)
+    {
+        if(current_type() == TokenType::SEMICOLON)
+        {
+            m_tokens_buffer.advance();
+            continue;
+        }
+
+        program.statements.append(parse_statement());
+    }
+
+    program.symbol_count = m_symbol_count;
+
+    return program;
+}
+
+Statement* Parser::parse_statement()
+{
+    switch(current_type())
+    {
+        case TokenType::USE:
+            return parse_use();
+        case TokenType::MUT:
+            return parse_declaration(false);
+        case TokenType::CONST:
+            return parse_declaration(true);
+        case TokenType::IDENTIFIER:
+            if(m_tokens_buffer.peek(1).get_type() == TokenType::LPAREN)
+            {
+                CallExpression* call = parse_call();
+                expect(TokenType::SEMICOLON, "Expected for ';'");
+
+                return m_arena.make<CallStatement>(call);
+            }
+            return parse_assign();
+        case TokenType::WRITELN:
+            return parse_writeln();
+        case TokenType::EXIT:
+            return parse_exit();
+        case TokenType::WHILE:
+            return parse_while();
+        case TokenType::FOR:
+            return parse_for();
+        case TokenType::FN:
+            return parse_function();
+        case TokenType::RETURN:
+            return parse_return();
+        default:
+            std::cerr << "Syntax error. Unexpected token '" << current_value() << "'" << std::endl;
+            exit(EXIT_FAILURE);
+    }
+}
+
+Statement* Parser::parse_use()
+{
+    m_tokens_buffer.advance();
+    check_token_type(TokenType::IDENTIFIER, "Expected module name after 'use'");
+    std::string_view name = current_value();
+    m_tokens_buffer.advance();
+
+    expect(TokenType::SEMICOLON, "Expected ';' after module name");
+
+    if(name == "io")
+    {
+        return m_arena.make<UseIoStatement>();
+    }
+
+    return m_arena.make<UseModuleStatement>(name);
+}
+
+Statement* Parser::parse_declaration(bool is_const)
+{
+    m_tokens_buffer.advance();
+    check_token_type(TokenType::IDENTIFIER, is_const ? "Expected identifier after 'const'" : "Expected identifier after 'mut'");
+    std::string_view variable_name = current_value();
+    uint32_t symbol = take_symbol();
+    m_tokens_buffer.advance();
+
+    expect(TokenType::ASSIGN, "Expected '=' after identifier");
+
+    Expression* value = parse_value();
+
+    expect(TokenType::SEMICOLON, "Expected for ';'");
+
+    return m_arena.make<DeclarationStatement>(variable_name, symbol, is_const, value);
+}
+
+Statement* Parser::parse_assign()
+{
+    Statement* assign = parse_assign_expression();
+
+    expect(TokenType::SEMICOLON, "Expected for ';'");
+
+    return assign;
+}
+
+// `name = value` or `name[index] = value` without the trailing ';', also
+// the step of a for loop.
+Statement* Parser::parse_assign_expression()
+{
+    check_token_type(TokenType::IDENTIFIER, "Expected identifier");
+    std::string_view variable_name = current_value();
+    uint32_t symbol = take_symbol();
+    m_tokens_buffer.advance();
+
+    Expression* index = nullptr;
+
+    if(current_type() == TokenType::LBRACKET)
+    {
+        m_tokens_buffer.advance();
+        index = parse_expr();
+        expect(TokenType::RBRACKET, "Expected ']' after index.");
+    }
+
+    expect(TokenType::ASSIGN, "Expected '=' after identifier");
+
+    Expression* value = parse_value();
+
+    if(index)
+    {
+        return m_arena.make<IndexAssignStatement>(variable_name, symbol, index, value);
+    }
+
+    return m_arena.make<AssignStatement>(variable_name, symbol, value);
+}
+
+Statement* Parser::parse_while()
+{
+    m_tokens_buffer.advance();
+    expect(TokenType::LPAREN, "Expected '(' after 'while'.");
+
+    Expression* condition = parse_value();
+
+    expect(TokenType::RPAREN, "Expected ')' after loop condition.");
+
+    return m_arena.make<WhileStatement>(condition, parse_block());
+}
+
+Statement* Parser::parse_for()
+{
+    m_tokens_buffer.advance();
+    expect(TokenType::LPAREN, "Expected '(' after 'for'.");
+
+    // Both forms of init consume their ';'.
+    Statement* init = current_type() == TokenType::MUT ? parse_declaration(false) : parse_assign();
+
+    Expression* condition = parse_value();
+    expect(TokenType::SEMICOLON, "Expected ';' after loop condition.");
+
+    Statement* step = parse_assign_expression();
+    expect(TokenType::RPAREN, "Expected ')' after loop step.");
+
+    return m_arena.make<ForStatement>(init, condition, step, parse_block());
+}
+
+Statement* Parser::parse_function()
+{
+    m_tokens_buffer.advance();
+    check_token_type(TokenType::IDENTIFIER, "Expected function name after 'fn'");
+    std::string_view name = current_value();
+    uint32_t symbol = take_symbol();
+    m_tokens_buffer.advance();
+
+    expect(TokenType::LPAREN, "Expected '(' after function name.");
+
+    std::vector<Parameter> parameters;
+
+    while(current_type() != TokenType::RPAREN)
+    {
+        if(!parameters.empty())
+        {
+            expect(TokenType::COMMA, "Expected ',' between parameters.");
+        }
+
+        check_token_type(TokenType::IDENTIFIER, "Expected parameter name.");
+        std::string_view parameter_name = current_value();
+        uint32_t parameter_symbol = take_symbol();
+        m_tokens_buffer.advance();
+
+        expect(TokenType::COLON, "Expected ':' after parameter name.");
+        parameters.push_back({ parameter_name, parameter_symbol, parse_type() });
+    }
+
+    m_tokens_buffer.advance();
+
+    TypeAnnotation return_type = TypeAnnotation::NONE;
+
+    if(current_type() == TokenType::COLON)
+    {
+        m_tokens_buffer.advance();
+        return_type = parse_type();
+    }
+
+    StatementList body = parse_block();
+
+    return m_arena.make<FunctionStatement>(name, symbol, m_arena.make_array(parameters.data(), parameters.size()),
+                                           static_cast<uint32_t>(parameters.size()), return_type, body);
+}
+
+Statement* Parser::parse_return()
+{
+    m_tokens_buffer.advance();
+
+    Expression* value = nullptr;
+
+    if(current_type() != TokenType::SEMICOLON)
+    {
+        value = parse_value();
+    }
+
+    expect(TokenType::SEMICOLON, "Expected ';' after return.");
+
+    return m_arena.make<ReturnStatement>(value);
+}
+
+// Type names are plain identifiers, not keywords.
+TypeAnnotation Parser::parse_type()
+{
+    check_token_type(TokenType::IDENTIFIER, "Expected type name.");
+    std::string_view name = current_value();
+    m_tokens_buffer.advance();
+
+    if(name == "int")
+        return TypeAnnotation::INT;
+    if(name == "float")
+        return TypeAnnotation::FLOAT;
+    if(name == "bool")
+        return TypeAnnotation::BOOL;
+    if(name == "str")
+        return TypeAnnotation::STR;
+
+    std::cerr << "Syntax error. Unknown type '" << name << "'" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+CallExpression* Parser::parse_call()
+{
+    std::string_view name = current_value();
+    uint32_t symbol = take_symbol();
+    m_tokens_buffer.advance();
+
+    expect(TokenType::LPAREN, "Expected '(' after function name.");
+
+    std::vector<Expression*> arguments;
+
+    while(current_type() != TokenType::RPAREN)
+    {
+        if(!arguments.empty())
+        {
+            expect(TokenType::COMMA, "Expected ',' between arguments.");
+        }
+
+        arguments.push_back(parse_value());
+    }
+
+    m_tokens_buffer.advance();
+
+    return m_arena.make<CallExpression>(name, symbol, m_arena.make_array(arguments.data(), arguments.size()),
+                                        static_cast<uint32_t>(arguments.size()));
+}
+
+// `[a, b, c]` or `[value; length]`, where the length is an integer literal.
+Expression* Parser::parse_array()
+{
+    m_tokens_buffer.advance();
+
+    std::vector<Expression*> elements;
+    elements.push_back(parse_expr());
+
+    if(current_type() == TokenType::SEMICOLON)
+    {
+        m_tokens_buffer.advance();
+        check_token_type(TokenType::INT_LITERAL, "Expected array length after ';'.");
+
+        int64_t length = m_tokens_buffer.current().get_integer();
+
+        if(length <= 0)
+        {
+            std::cerr << "Syntax error. Invalid array length '" << current_value() << "'." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        m_tokens_buffer.advance();
+        expect(TokenType::RBRACKET, "Expected ']' after array length.");
+
+        return m_arena.make<ArrayFillExpression>(elements.front(), length);
+    }
+
+    while(current_type() != TokenType::RBRACKET)
+    {
+        expect(TokenType::COMMA, "Expected ',' between array elements.");
+        elements.push_back(parse_expr());
+    }
+
+    m_tokens_buffer.advance();
+
+    return m_arena.make<ArrayExpression>(m_arena.make_array(elements.data(), elements.size()),
+                                         static_cast<uint32_t>(elements.size()));
+}
+
+Expression* Parser::parse_index()
+{
+    std::string_view name = current_value();
+    uint32_t symbol = take_symbol();
+    m_tokens_buffer.advance();
+
+    expect(TokenType::LBRACKET, "Expected '['.");
+    Expression* index = parse_expr();
+    expect(TokenType::RBRACKET, "Expected ']' after index.");
+
+    return m_arena.make<IndexExpression>(name, symbol, index);
+}
+
+StatementList Parser::parse_block()
+{
+    expect(TokenType::LBRACE, "Expected '{'.");
+
+    StatementList statements;
+
+    while(current_type() != TokenType::RBRACE)
+    {
+        if(current_type() == TokenType::END_OF_FILE)
+        {
+            std::cerr << "Syntax error. Expected '}' before end of file." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        if(current_type() == TokenType::SEMICOLON)
+        {
+            m_tokens_buffer.advance();
+            continue;
+        }
+
+        statements.append(parse_statement());
+    }
+
+    m_tokens_buffer.advance();
+
+    return statements;
+}
+
+Statement* Parser::parse_writeln()
+{
+    m_tokens_buffer.advance();
+    expect(TokenType::LPAREN, "Expected '(' after 'writeln'.");
+
+    Expression* value = parse_value();
+
+    expect(TokenType::RPAREN, "Expected ')' after writeln argument.");
+    expect(TokenType::SEMICOLON, "Expected for ';'");
+
+    return m_arena.make<WritelnStatement>(value);
+}
+
+Statement* Parser::parse_exit()
+{
+    m_tokens_buffer.advance();
+    expect(TokenType::LPAREN, "Expected for '(");
+
+    Expression* value = parse_expr();
+
+    expect(TokenType::RPAREN, "Expected ')'");
+    expect(TokenType::SEMICOLON, "Expected ';'");
+
+    return m_arena.make<ExitStatement>(value);
+}
+
+// Right-hand side of a declaration or assignment, or a writeln argument.
+Expression* Parser::parse_value()
+{
+    if(current_type() == TokenType::CHECK)
+    {
+        return parse_check();
+    }
+
+    return parse_operand();
+}
+
+Expression* Parser::parse_check()
+{
+    m_tokens_buffer.advance();
+
+    Expression* left = parse_operand();
+    TokenType op = current_type();
+
+    if(op != TokenType::EQUAL && op != TokenType::NOT_EQUAL && op != TokenType::LESS && op != TokenType::MORE)
+    {
+        std::cerr << "Unexpected logical operator '" << current_value() << "'" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    m_tokens_buffer.advance();
+
+    Expression* right = parse_operand();
+
+    return m_arena.make<CompareExpression>(op, left, right);
+}
+
+Expression* Parser::parse_operand()
+{
+    switch(current_type())
+    {
+        case TokenType::QOUTE:
+            return parse_string_literal();
+        case TokenType::TRUE:
+        case TokenType::FALSE:
+        {
+            bool value = current_type() == TokenType::TRUE;
+            m_tokens_buffer.advance();
+
+            return m_arena.make<BoolExpression>(value);
+        }
+        default:
+            return parse_expr();
+    }
+}
+
+Expression* Parser::parse_string_literal()
+{
+    m_tokens_buffer.advance();
+    check_token_type(TokenType::STRING_LITERAL, "Expected string literal after '\"'");
+
+    std::string_view value = current_value();
+    m_tokens_buffer.advance();
+
+    expect(TokenType::QOUTE, "Expected '\"' after string literal");
+
+    return m_arena.make<StringExpression>(value);
+}
+
+Expression* Parser::parse_expr()
+{
+    Expression* value = parse_term();
+
+    while(current_type() == TokenType::PLUS || current_type() == TokenType::MINUS)
+    {
+        TokenType operation = current_type();
+        m_tokens_buffer.advance();
+
+        value = m_arena.make<BinaryExpression>(operation, value, parse_term());
+    }
+
+    return value;
+}
+
+Expression* Parser::parse_term()
+{
+    Expression* value = parse_factor();
+
+    while(current_type() == TokenType::MUL || current_type() == TokenType::DIV)
+    {
+        TokenType operation = current_type();
+        m_tokens_buffer.advance();
+
+        value = m_arena.make<BinaryExpression>(operation, value, parse_factor());
+    }
+
+    return value;
+}
+
+Expression* Parser::parse_factor()
+{
+    const Token& token = m_tokens_buffer.current();
+
+    switch(token.get_type())
+    {
+        case TokenType::LPAREN:
+        {
+            m_tokens_buffer.advance();
+            Expression* value = parse_expr();
+            expect(TokenType::RPAREN, "Expected ')' after expression in parentheses");
+
+            return value;
+        }
+        case TokenType::INT_LITERAL:
+        {
+            Expression* value = m_arena.make<IntegerExpression>(token.get_integer());
+            m_tokens_buffer.advance();
+
+            return value;
+        }
+        case TokenType::FLOAT_LITERAL:
+        {
+            Expression* value = m_arena.make<FloatExpression>(token.get_number());
+            m_tokens_buffer.advance();
+
+            return value;
+        }
+        case TokenType::LBRACKET:
+            return parse_array();
+        case TokenType::IDENTIFIER:
+        {
+            if(m_tokens_buffer.peek(1).get_type() == TokenType::LPAREN)
+            {
+                return parse_call();
+            }
+
+            if(m_tokens_buffer.peek(1).get_type() == TokenType::LBRACKET)
+            {
+                return parse_index();
+            }
+
+            Expression* value = m_arena.make<VariableExpression>(token.get_value(), take_symbol());
+            m_tokens_buffer.advance();
+
+            return value;
+        }
+        default:
+            std::cerr << "Unexpected token. Expected integer literal, identifier, '(' or '['." << std::endl;
+            exit(EXIT_FAILURE);
+    }
+}
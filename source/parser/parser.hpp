@@ -0,0 +1,55 @@
+#pragma once
+
+#include "../ast/arena.hpp"
+#include "../ast/ast.hpp"
+#include "../token/token_buffer/token_buffer.hpp"
+
+#include <string_view>
+
+// Builds the AST of a program into an arena. The parser only checks
+// syntax; names and types are resolved when LLVMCompiler lowers the tree.
+class Parser
+{
+private:
+    TokenBuffer m_tokens_buffer;
+    Arena& m_arena;
+    uint32_t m_symbol_count = 0;
+
+    TokenType current_type() const;
+    std::string_view current_value() const;
+
+    void check_token_type(TokenType expected_type, std::string_view error_message) const;
+    void expect(TokenType expected_type, std::string_view error_message);
+    uint32_t take_symbol();
+
+    Statement* parse_statement();
+    Statement* parse_use();
+    Statement* parse_declaration(bool is_const);
+    Statement* parse_assign();
+    Statement* parse_assign_expression();
+    Statement* parse_while();
+    Statement* parse_for();
+    StatementList parse_block();
+    Statement* parse_function();
+    Statement* parse_return();
+    TypeAnnotation parse_type();
+    CallExpression* parse_call();
+    Expression* parse_array();
+    Expression* parse_index();
+    Statement* parse_writeln();
+    Statement* parse_exit();
+
+    Expression* parse_value();
+    Expression* parse_check();
+    Expression* parse_operand();
+    Expression* parse_string_literal();
+
+    Expression* parse_expr();
+    Expression* parse_term();
+    Expression* parse_factor();
+
+public:
+    Parser(TokenBuffer tokens_buffer, Arena& arena);
+
+    Program parse();
+};
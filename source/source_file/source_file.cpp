@@ -0,0 +1,50 @@
+#include "source_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceFile::SourceFile(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if(fd < 0)
+    {
+        throw std::runtime_error("Failed to open source file '" + path + "'.");
+    }
+
+    struct stat file_stat;
+
+    if(fstat(fd, &file_stat) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Failed to read size of source file '" + path + "'.");
+    }
+
+    m_size = static_cast<size_t>(file_stat.st_size);
+
+    if(m_size != 0)
+    {
+        void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(mapping == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Failed to map source file '" + path + "'.");
+        }
+
+        madvise(mapping, m_size, MADV_SEQUENTIAL);
+        m_data = static_cast<const char*>(mapping);
+    }
+
+    close(fd);
+}
+
+SourceFile::~SourceFile()
+{
+    if(m_data != nullptr)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+class SourceFile
+{
+private:
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+
+public:
+    explicit SourceFile(const std::string& path);
+    ~SourceFile();
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    inline std::string_view get_source() const { return std::string_view(m_data, m_size); }
+};
@@ -0,0 +1,25 @@
+#include "string_interner.hpp"
+
+uint32_t StringInterner::intern(std::string_view value)
+{
+    auto [it, inserted] = m_ids.try_emplace(value, static_cast<uint32_t>(m_strings.size()));
+
+    if(inserted)
+    {
+        m_strings.push_back(value);
+    }
+
+    return it->second;
+}
+
+std::optional<uint32_t> StringInterner::find(std::string_view value) const
+{
+    auto it = m_ids.find(value);
+
+    if(it == m_ids.end())
+    {
+        return std::nullopt;
+    }
+
+    return it->second;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class StringInterner
+{
+private:
+    std::unordered_map<std::string_view, uint32_t> m_ids;
+    std::vector<std::string_view> m_strings;
+
+public:
+    uint32_t intern(std::string_view value);
+    // ID of an already interned string, if it was seen.
+    std::optional<uint32_t> find(std::string_view value) const;
+
+    inline std::string_view get(uint32_t id) const { return m_strings[id]; }
+    inline size_t size() const { return m_strings.size(); }
+};
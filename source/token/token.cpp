@@ -1,15 +1,22 @@
 #include "token.hpp"
 #include <optional>
 
-Token::Token(TokenType type, std::string value)
-    : m_type(type), m_value(std::move(value)) {}
+Token::Token() {}
 
-TokenType Token::get_type() const { return m_type; }
+Token::Token(TokenType type, std::string_view value)
+    : m_type(type), m_value(value) {}
 
-std::string Token::get_value() const { return m_value; }
+Token::Token(TokenType type, std::string_view value, uint32_t symbol)
+    : m_type(type), m_symbol(symbol), m_value(value) {}
+
+Token::Token(TokenType type, std::string_view value, double number)
+    : m_type(type), m_number(number), m_value(value) {}
+
+Token::Token(TokenType type, std::string_view value, int64_t integer)
+    : m_type(type), m_integer(integer), m_value(value) {}
 
 void Token::display() const
 {
     std::cout << "Type: " << token_type_to_string(m_type) << "\t";
     std::cout << "Value: " << m_value << std::endl;
-}
\ No newline at end of file
+}
@@ -2,20 +2,40 @@
 
 #include "token_type.hpp"
 
+#include <cstdint>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <optional>
 
 class Token
 {
 private:
-    TokenType m_type;
-    std::string m_value;
+    TokenType m_type = TokenType::END_OF_FILE;
+    // Payload keyed by m_type: the value of a float or integer literal, or
+    // the interned id of anything else (0 when it has none).
+    union
+    {
+        uint32_t m_symbol = 0;
+        double m_number;
+        int64_t m_integer;
+    };
+    std::string_view m_value;
 public:
-    Token(TokenType type, std::string value);
+    Token();
+    Token(TokenType type, std::string_view value);
+    Token(TokenType type, std::string_view value, uint32_t symbol);
+    Token(TokenType type, std::string_view value, double number);
+    Token(TokenType type, std::string_view value, int64_t integer);
 
-    TokenType get_type() const;
-    std::string get_value() const;
+    inline TokenType get_type() const { return m_type; }
+    inline std::string_view get_value() const { return m_value; }
+
+    // Interned id of an identifier or string literal.
+    inline uint32_t get_symbol() const { return m_symbol; }
+    // Values of float and integer literals, parsed once by the lexer.
+    inline double get_number() const { return m_number; }
+    inline int64_t get_integer() const { return m_integer; }
 
     void display() const;
-};
\ No newline at end of file
+};
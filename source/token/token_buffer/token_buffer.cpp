@@ -1,17 +1,30 @@
 #include "token_buffer.hpp"
 
-std::vector<Token>::const_iterator TokenBuffer::begin() const { return m_tokens.begin(); }
-std::vector<Token>::const_iterator TokenBuffer::end() const { return m_tokens.end(); }
+TokenBuffer::TokenBuffer(Lexer& lexer)
+    : m_lexer(&lexer)
+{
+    m_lookahead[m_head] = pull_token();
+    m_size = 1;
+}
 
-TokenBuffer::TokenBuffer(std::vector<Token> tokens)
-    : m_tokens(std::move(tokens)), m_current(m_tokens.at(0)) {}
+TokenBuffer::TokenBuffer(TokenStream tokens)
+    : m_tokens(std::move(tokens))
+{
+    m_lookahead[m_head] = pull_token();
+    m_size = 1;
+}
 
-void TokenBuffer::move_next()
+Token TokenBuffer::pull_token()
 {
-    ++pos;
+    if(m_lexer != nullptr)
+    {
+        return m_lexer->next_token();
+    }
 
-    if(!(pos >= m_tokens.size()))
+    if(m_stream_pos < m_tokens.size())
     {
-        m_current = m_tokens.at(pos);
+        return m_tokens[m_stream_pos++];
     }
-}
\ No newline at end of file
+
+    return Token();
+}
@@ -1,22 +1,66 @@
 #pragma once
 
 #include "../token.hpp"
+#include "../token_stream/token_stream.hpp"
+#include "../../lexer/lexer.hpp"
 
-#include <vector>
+#include <array>
+#include <cassert>
+#include <string_view>
 
+// Cursor over the tokens of a program, fed either by a lexer, pulling them
+// on demand, or by an already lexed TokenStream. The current token and the
+// ones peeked ahead of it live in a small ring buffer and are dropped as
+// soon as the cursor moves past them.
 class TokenBuffer
 {
-public:
-    std::vector<Token> m_tokens;
-    Token m_current;
-    size_t pos = 0;
+private:
+    static constexpr size_t LOOKAHEAD_CAPACITY = 8;
+    static constexpr size_t LOOKAHEAD_MASK = LOOKAHEAD_CAPACITY - 1;
+
+    static_assert((LOOKAHEAD_CAPACITY & LOOKAHEAD_MASK) == 0, "Lookahead capacity must be a power of two.");
+
+    Lexer* m_lexer = nullptr;
+    TokenStream m_tokens;
+    size_t m_stream_pos = 0;
+
+    std::array<Token, LOOKAHEAD_CAPACITY> m_lookahead;
+    size_t m_head = 0;
+    size_t m_size = 0;
+
+    Token pull_token();
 
 public:
-    TokenBuffer();
-    TokenBuffer(std::vector<Token> tokens);
+    explicit TokenBuffer(Lexer& lexer);
+    explicit TokenBuffer(TokenStream tokens);
+
+    inline const Token& current() const { return m_lookahead[m_head]; }
+    inline TokenType current_type() const { return current().get_type(); }
+    inline std::string_view current_value() const { return current().get_value(); }
+
+    // Token k positions after the current one, peek(0) being the current
+    // token. k must stay below LOOKAHEAD_CAPACITY.
+    inline const Token& peek(size_t k)
+    {
+        assert(k < LOOKAHEAD_CAPACITY);
+
+        while (m_size <= k)
+        {
+            m_lookahead[(m_head + m_size) & LOOKAHEAD_MASK] = pull_token();
+            ++m_size;
+        }
+
+        return m_lookahead[(m_head + k) & LOOKAHEAD_MASK];
+    }
 
-    void move_next();
+    inline void advance()
+    {
+        m_head = (m_head + 1) & LOOKAHEAD_MASK;
 
-    std::vector<Token>::const_iterator begin() const;
-    std::vector<Token>::const_iterator end() const;
-};
\ No newline at end of file
+        if (--m_size == 0)
+        {
+            m_lookahead[m_head] = pull_token();
+            m_size = 1;
+        }
+    }
+};
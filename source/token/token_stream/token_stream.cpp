@@ -0,0 +1,65 @@
+#include "token_stream.hpp"
+
+TokenStream::TokenStream(std::string_view source)
+    : m_source(source) {}
+
+void TokenStream::reserve(size_t count)
+{
+    m_types.reserve(count);
+    m_offsets.reserve(count);
+    m_lengths.reserve(count);
+    m_payloads.reserve(count);
+}
+
+void TokenStream::push(const Token& token)
+{
+    TokenType type = token.get_type();
+    std::string_view value = token.get_value();
+
+    m_types.push_back(type);
+    m_offsets.push_back(static_cast<uint32_t>(value.data() - m_source.data()));
+    m_lengths.push_back(static_cast<uint32_t>(value.size()));
+
+    if(type == TokenType::INT_LITERAL)
+    {
+        m_payloads.push_back(static_cast<uint32_t>(m_integers.size()));
+        m_integers.push_back(token.get_integer());
+    }
+    else if(type == TokenType::FLOAT_LITERAL)
+    {
+        m_payloads.push_back(static_cast<uint32_t>(m_numbers.size()));
+        m_numbers.push_back(token.get_number());
+    }
+    else
+    {
+        m_payloads.push_back(token.get_symbol());
+    }
+}
+
+Token TokenStream::operator[](size_t index) const
+{
+    TokenType type = m_types[index];
+    std::string_view value = m_source.substr(m_offsets[index], m_lengths[index]);
+
+    if(type == TokenType::INT_LITERAL)
+    {
+        return Token(type, value, m_integers[m_payloads[index]]);
+    }
+
+    if(type == TokenType::FLOAT_LITERAL)
+    {
+        return Token(type, value, m_numbers[m_payloads[index]]);
+    }
+
+    return Token(type, value, m_payloads[index]);
+}
+
+Token TokenStream::at(size_t index) const
+{
+    if(index >= size())
+    {
+        throw std::out_of_range("Token index out of range.");
+    }
+
+    return (*this)[index];
+}
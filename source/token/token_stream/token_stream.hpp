@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../token.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+// Struct-of-arrays storage for lexed tokens. Token text is kept as an
+// offset/length pair into the source, and literal payloads live in side
+// tables: numbers are parsed once by the lexer, integers kept exact in a
+// table of their own, and identifiers and string literals are stored by
+// their interned id.
+class TokenStream
+{
+private:
+    std::string_view m_source;
+
+    std::vector<TokenType> m_types;
+    std::vector<uint32_t> m_offsets;
+    std::vector<uint32_t> m_lengths;
+    std::vector<uint32_t> m_payloads;
+    std::vector<double> m_numbers;
+    std::vector<int64_t> m_integers;
+
+public:
+    TokenStream() = default;
+    explicit TokenStream(std::string_view source);
+
+    // Makes room for count tokens up front; pages never written to are not
+    // committed, so generous estimates are cheap.
+    void reserve(size_t count);
+    void push(const Token& token);
+
+    Token operator[](size_t index) const;
+    Token at(size_t index) const;
+
+    inline size_t size() const { return m_types.size(); }
+    inline bool empty() const { return m_types.empty(); }
+};
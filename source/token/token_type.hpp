@@ -1,92 +1,80 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <sstream>
 
-enum class TokenType
+// Single source of truth for token types: X(type, name, keyword).
+// Entries with a non-empty keyword spelling are recognised by the lexer
+// through the perfect-hash table in lexer/keyword_table.hpp.
+#define DUST_TOKEN_TYPES(X)                              \
+    X(EXIT,           "EXIT",           "exit")          \
+    X(INT_LITERAL,    "INT_LITERAL",    "")              \
+    X(FLOAT_LITERAL,  "FLOAT_LITERAL",  "")              \
+    X(STRING_LITERAL, "STRING_LITERAL", "")              \
+    X(TRUE,           "TRUE",           "true")          \
+    X(FALSE,          "FALSE",          "false")         \
+    X(LPAREN,         "LPAREN",         "")              \
+    X(RPAREN,         "RPAREN",         "")              \
+    X(SEMICOLON,      "SEMICOLON",      "")              \
+    X(WRITELN,        "WRITELN",        "writeln")       \
+    X(QOUTE,          "QOUTE",          "")              \
+    X(MUT,            "MUT",            "mut")           \
+    X(CONST,          "CONST",          "const")         \
+    X(ASSIGN,         "ASSIGN",         "")              \
+    X(IDENTIFIER,     "IDENTIFIER",     "")              \
+    X(PLUS,           "PLUS",           "")              \
+    X(MINUS,          "MINUS",          "")              \
+    X(MUL,            "MUL",            "")              \
+    X(DIV,            "DIV",            "")              \
+    X(USE,            "USE",            "use")           \
+    X(CHECK,          "CHECK",          "")              \
+    X(MORE,           "MORE",           "")              \
+    X(LESS,           "LESS",           "")              \
+    X(EQUAL,          "EQUAL",          "")              \
+    X(NOT_EQUAL,      "NOT EQUAL",      "")              \
+    X(WHILE,          "WHILE",          "while")         \
+    X(FOR,            "FOR",            "for")           \
+    X(LBRACE,         "LBRACE",         "")              \
+    X(RBRACE,         "RBRACE",         "")              \
+    X(FN,             "FN",             "fn")            \
+    X(RETURN,         "RETURN",         "return")        \
+    X(COMMA,          "COMMA",          "")              \
+    X(COLON,          "COLON",          "")              \
+    X(LBRACKET,       "LBRACKET",       "")              \
+    X(RBRACKET,       "RBRACKET",       "")              \
+    X(END_OF_FILE,    "END_OF_FILE",    "")
+
+enum class TokenType : uint8_t
 {
-    EXIT,
-    INT_LITERAL,
-    FLOAT_LITERAL,
-    STRING_LITERAL,
-    TRUE,
-    FALSE,
-    LPAREN,
-    RPAREN,
-    SEMICOLON,
-    WRITELN,
-    QOUTE,
-    MUT,
-    CONST,
-    ASSIGN,
-    IDENTIFIER,
-    PLUS,
-    MINUS,
-    MUL,
-    DIV,
-    USE_IO,
-    CHECK,
-    MORE,
-    LESS,
-    EQUAL,
-    NOT_EQUAL
+#define DUST_TOKEN_ENUM(type, name, keyword) type,
+    DUST_TOKEN_TYPES(DUST_TOKEN_ENUM)
+#undef DUST_TOKEN_ENUM
+};
+
+struct TokenTypeInfo
+{
+    TokenType type;
+    std::string_view name;
+    std::string_view keyword;
+};
+
+inline constexpr TokenTypeInfo token_type_infos[] =
+{
+#define DUST_TOKEN_INFO(type, name, keyword) { TokenType::type, name, keyword },
+    DUST_TOKEN_TYPES(DUST_TOKEN_INFO)
+#undef DUST_TOKEN_INFO
 };
 
 inline std::string token_type_to_string(TokenType m_type)
 {
-    switch (m_type)
+    size_t index = static_cast<size_t>(m_type);
+
+    if (index >= std::size(token_type_infos))
     {
-        case TokenType::EXIT:
-            return "EXIT";
-        case TokenType::CHECK:
-            return "CHECK";
-        case TokenType::MORE:
-            return "MORE";
-        case TokenType::NOT_EQUAL:
-            return "NOT EQUAL";
-        case TokenType::LESS:
-            return "LESS";
-        case TokenType::EQUAL:
-            return "EQUAL";
-        case TokenType::CONST:
-            return "CONST";
-        case TokenType::TRUE:
-            return "TRUE";
-        case TokenType::FALSE:
-            return "FALSE";
-        case TokenType::INT_LITERAL:
-            return "INT_LITERAL";
-        case TokenType::USE_IO:
-            return "USE_IO";
-        case TokenType::PLUS:
-            return "PLUS";
-        case TokenType::MINUS:
-            return "MINUS";
-        case TokenType::DIV:
-            return "DIV";
-        case TokenType::MUL:
-            return "MUL";
-        case TokenType::LPAREN:
-            return "LPAREN";
-        case TokenType::RPAREN:
-            return "RPAREN";
-        case TokenType::SEMICOLON:
-            return "SEMICOLON";
-        case TokenType::WRITELN:
-            return "WRITELN";
-        case TokenType::STRING_LITERAL:
-            return "STRING_LITERAL";
-        case TokenType::QOUTE:
-            return "QOUTE";
-        case TokenType::MUT:
-            return "MUT";
-        case TokenType::ASSIGN:
-            return "ASSIGN";
-        case TokenType::IDENTIFIER:
-            return "IDENTIFIER";
-        case TokenType::FLOAT_LITERAL:
-            return "FLOAT_LITERAL";
-        default:
-            return "UNKNOWN";
+        return "UNKNOWN";
     }
-}
\ No newline at end of file
+
+    return std::string(token_type_infos[index].name);
+}
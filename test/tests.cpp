@@ -2,15 +2,68 @@
 #include <vector>
 
 #include "../source/lexer/lexer.hpp"
+#include "../source/lexer/keyword_table.hpp"
+#include "../source/lexer/char_scanner.hpp"
 #include "../source/token/token_buffer/token_buffer.hpp"
+#include "../source/ast/arena.hpp"
+#include "../source/parser/parser.hpp"
 #include "../source/compiler/llvm_compiler.hpp"
+#include "../source/compiler/llvm_jit_runner.hpp"
+#include "../source/compiler/llvm_target.hpp"
+#include "../source/driver/build_cache.hpp"
+#include "../source/driver/command_line.hpp"
+#include "../source/driver/program_builder.hpp"
+
+#include <llvm/Support/Host.h>
+
+#include <filesystem>
+#include <fstream>
+
+#include <unistd.h>
+
+// Parses source and lowers it into a fresh compiler.
+static std::unique_ptr<LLVMCompiler> compile(std::string_view source, bool fast_math = false)
+{
+    Lexer lexer(source);
+
+    Arena arena;
+    Program program = Parser(TokenBuffer(lexer), arena).parse();
+
+    std::unique_ptr<LLVMCompiler> compiler = std::make_unique<LLVMCompiler>("test_prog", fast_math);
+    compiler->generate(program);
+
+    return compiler;
+}
+
+struct RunResult
+{
+    int64_t exit_code;
+    std::string output;
+};
+
+// JIT-runs a compiled program, capturing what it writes to stdout.
+static RunResult run_and_capture(LLVMCompiler& compiler, llvm::OptimizationLevel level = llvm::OptimizationLevel::O0)
+{
+    compiler.verify_module();
+    LLVMJitRunner runner(compiler.release_module(), level);
+
+    testing::internal::CaptureStdout();
+    int64_t exit_code = runner.run();
+
+    return { exit_code, testing::internal::GetCapturedStdout() };
+}
+
+static RunResult run_and_capture(std::string_view source, llvm::OptimizationLevel level = llvm::OptimizationLevel::O0)
+{
+    return run_and_capture(*compile(source), level);
+}
 
 TEST(LexerTest, TokenizeTest)
 {
     const std::string source = "mut a = ? 5+2 == 10.5;";
 
     Lexer lexer(std::move(source));
-    std::vector<Token> tokens = lexer.tokenize();
+    TokenStream tokens = lexer.tokenize();
 
     ASSERT_EQ(tokens.size(), 10);
 
@@ -35,40 +88,478 @@ TEST(LexerTest, LexerSourcePassing)
 
     Lexer lexer(source);
 
-    const std::vector<Token> tokens = lexer.tokenize();
+    const TokenStream tokens = lexer.tokenize();
 
     EXPECT_EQ(source, lexer.get_source());
 }
 
+TEST(LexerTest, LiteralPayloads)
+{
+    Lexer lexer("mut a = a + 2.5; writeln(\"a\"); exit(9007199254740993);");
+    TokenStream tokens = lexer.tokenize();
+
+    ASSERT_EQ(tokens.size(), 19);
+
+    EXPECT_EQ(tokens[1].get_symbol(), tokens[3].get_symbol());
+    EXPECT_EQ(tokens[1].get_symbol(), tokens[10].get_symbol());
+    EXPECT_DOUBLE_EQ(tokens[5].get_number(), 2.5);
+    EXPECT_EQ(tokens[16].get_integer(), 9007199254740993);
+    EXPECT_EQ(lexer.get_interner().size(), 1);
+    EXPECT_EQ(lexer.get_interner().get(tokens[1].get_symbol()), "a");
+
+    // The payloads share one 8-byte slot next to the text.
+    EXPECT_EQ(sizeof(Token), 2 * sizeof(uint64_t) + sizeof(std::string_view));
+}
+
+TEST(LexerTest, KeywordLookup)
+{
+    for (const TokenTypeInfo& info : token_type_infos)
+    {
+        if (!info.keyword.empty())
+        {
+            EXPECT_EQ(lookup_keyword(info.keyword), info.type);
+        }
+    }
+
+    EXPECT_EQ(lookup_keyword("muts"), std::nullopt);
+    EXPECT_EQ(lookup_keyword("exits"), std::nullopt);
+    EXPECT_EQ(lookup_keyword("x"), std::nullopt);
+    EXPECT_EQ(token_type_to_string(TokenType::NOT_EQUAL), "NOT EQUAL");
+}
+
+TEST(CharScannerTest, VectorizedScannersMatchScalar)
+{
+    std::string input;
+    for (int i = 0; i < 4096; ++i)
+    {
+        input.push_back(" \t\nab9\"Z0;\x80."[(i * 7 + i / 13) % 14]);
+        if (i % 97 == 0)
+            input.append(40, i % 2 ? ' ' : 'q');
+    }
+
+    const CharScanner* scalar = find_char_scanner("scalar");
+    ASSERT_NE(scalar, nullptr);
+
+    for (const char* name : { "sse2", "avx2" })
+    {
+        const CharScanner* scanner = find_char_scanner(name);
+        if (scanner == nullptr)
+            continue;
+
+        for (size_t pos = 0; pos <= input.size(); ++pos)
+        {
+            EXPECT_EQ(scanner->skip_whitespace(input.data(), input.size(), pos), scalar->skip_whitespace(input.data(), input.size(), pos));
+            EXPECT_EQ(scanner->identifier_end(input.data(), input.size(), pos), scalar->identifier_end(input.data(), input.size(), pos));
+            EXPECT_EQ(scanner->digits_end(input.data(), input.size(), pos), scalar->digits_end(input.data(), input.size(), pos));
+            EXPECT_EQ(scanner->find_quote(input.data(), input.size(), pos), scalar->find_quote(input.data(), input.size(), pos));
+        }
+    }
+}
+
 TEST(TokenBufferTest, VectorPassTest)
 {
-    std::string source = "mut a;";
+    const std::string source = "mut a;";
 
-    Lexer lexer(std::move(source));
+    Lexer lexer(source);
 
-    ASSERT_TRUE(source.empty());
-    ASSERT_EQ(source.size(), 0);
+    EXPECT_EQ(lexer.get_source().data(), source.data());
 
-    std::vector<Token> tokens = lexer.tokenize();
+    TokenStream tokens = lexer.tokenize();
 
     TokenBuffer buffer(std::move(tokens));
 
-    EXPECT_EQ(buffer.m_current.get_type(), TokenType::MUT);
-    EXPECT_EQ(buffer.m_current.get_value(), "mut");
+    EXPECT_EQ(buffer.current_type(), TokenType::MUT);
+    EXPECT_EQ(buffer.current_value(), "mut");
 
-    buffer.move_next();
+    buffer.advance();
 
-    EXPECT_EQ(buffer.m_current.get_type(), TokenType::IDENTIFIER);
+    EXPECT_EQ(buffer.current_type(), TokenType::IDENTIFIER);
 
-    ASSERT_EQ(buffer.m_tokens.size(), 3);
+    EXPECT_EQ(buffer.peek(1).get_type(), TokenType::SEMICOLON);
+    EXPECT_EQ(buffer.peek(2).get_type(), TokenType::END_OF_FILE);
 
     ASSERT_EQ(tokens.size(), 0);
     ASSERT_TRUE(tokens.empty());
 }
 
+TEST(LLVMCompilerTest, ExitKeepsModuleValid)
+{
+    std::unique_ptr<LLVMCompiler> compiler = compile("use io; mut a = 5; exit(a); writeln(a);");
+
+    EXPECT_FALSE(llvm::verifyModule(compiler->get_module()));
+}
+
+TEST(LLVMJitRunnerTest, ReturnsExitValue)
+{
+    EXPECT_EQ(run_and_capture("mut a = 5; exit(a * 2 + 1);").exit_code, 11);
+}
+
+TEST(TokenBufferTest, StreamsFromLexer)
+{
+    const std::string source = "writeln(\"hi\"); mut a = 1;";
+
+    Lexer stream_lexer(source);
+    TokenStream tokens = stream_lexer.tokenize();
+
+    Lexer lexer(source);
+    TokenBuffer buffer(lexer);
+
+    EXPECT_EQ(buffer.peek(3).get_type(), TokenType::STRING_LITERAL);
+    EXPECT_EQ(buffer.peek(3).get_value(), "hi");
+
+    for (size_t i = 0; i < tokens.size(); ++i)
+    {
+        EXPECT_EQ(buffer.current_type(), tokens[i].get_type());
+        EXPECT_EQ(buffer.current_value(), tokens[i].get_value());
+        buffer.advance();
+    }
+
+    EXPECT_EQ(buffer.current_type(), TokenType::END_OF_FILE);
+}
+
+TEST(ParserTest, ArithmeticPrecedence)
+{
+    Lexer lexer("mut a = 1 + 2 * 3; writeln(? a == 7);");
+
+    Arena arena;
+    Program program = Parser(TokenBuffer(lexer), arena).parse();
+
+    ASSERT_EQ(program.statements.count, 2);
+    ASSERT_EQ(program.statements.first->kind, StatementKind::DECLARATION);
+
+    const auto* declaration = static_cast<const DeclarationStatement*>(program.statements.first);
+    EXPECT_EQ(declaration->name, "a");
+    ASSERT_EQ(declaration->value->kind, ExpressionKind::BINARY);
+
+    const auto* sum = static_cast<const BinaryExpression*>(declaration->value);
+    EXPECT_EQ(sum->op, TokenType::PLUS);
+    ASSERT_EQ(sum->right->kind, ExpressionKind::BINARY);
+    EXPECT_EQ(static_cast<const BinaryExpression*>(sum->right)->op, TokenType::MUL);
+
+    const auto* writeln = static_cast<const WritelnStatement*>(program.statements.last);
+    EXPECT_EQ(writeln->value->kind, ExpressionKind::COMPARE);
+    EXPECT_GT(arena.get_bytes_allocated(), 0);
+}
+
+TEST(ParserTest, IdentifiersShareSymbols)
+{
+    Lexer lexer("mut a = 1; mut b = 2; a = b;");
+
+    Arena arena;
+    Program program = Parser(TokenBuffer(lexer), arena).parse();
+
+    const auto* first = static_cast<const DeclarationStatement*>(program.statements.first);
+    const auto* second = static_cast<const DeclarationStatement*>(first->next);
+    const auto* assign = static_cast<const AssignStatement*>(program.statements.last);
+
+    EXPECT_EQ(assign->symbol, first->symbol);
+    EXPECT_EQ(static_cast<const VariableExpression*>(assign->value)->symbol, second->symbol);
+    EXPECT_NE(first->symbol, second->symbol);
+    EXPECT_GT(program.symbol_count, second->symbol);
+}
+
+TEST(LLVMCompilerTest, OptimizationLevelsRunThePipeline)
+{
+    const char* source = "mut sum = 0; for (mut i = 0; ? i < 1000; i = i + 1) { sum = sum + i; } exit(sum);";
+
+    // optimize() also sets the triple and data layout, so only the code is
+    // compared.
+    auto get_code = [](const LLVMCompiler& compiler)
+    {
+        std::string ir = compiler.get_llvm_ir_as_string();
+        return ir.substr(ir.find("define"));
+    };
+
+    std::unique_ptr<LLVMCompiler> unoptimized = compile(source);
+    std::string code = get_code(*unoptimized);
+    unoptimized->optimize(llvm::OptimizationLevel::O0, *create_target_machine(llvm::OptimizationLevel::O0));
+
+    EXPECT_NE(code.find("alloca"), std::string::npos);
+    EXPECT_EQ(get_code(*unoptimized), code);
+
+    std::unique_ptr<LLVMCompiler> optimized = compile(source);
+    optimized->optimize(llvm::OptimizationLevel::O2, *create_target_machine(llvm::OptimizationLevel::O2));
+    std::string ir = optimized->get_llvm_ir_as_string();
+
+    EXPECT_NE(ir.find("ret i64 499500"), std::string::npos);
+    EXPECT_EQ(ir.find("alloca"), std::string::npos);
+}
+
+TEST(LLVMJitRunnerTest, IntegersKeepFullPrecision)
+{
+    std::unique_ptr<LLVMCompiler> compiler = compile("mut a = 9007199254740993; exit(a - 9007199254740992 + 7 / 2);");
+
+    EXPECT_EQ(compiler->get_llvm_ir_as_string().find("double"), std::string::npos);
+    EXPECT_EQ(run_and_capture(*compiler).exit_code, 4);
+}
+
+TEST(LLVMCompilerTest, BooleansShareTheirStrings)
+{
+    std::unique_ptr<LLVMCompiler> compiler = compile("use io; mut a = ? 1 < 2.5; writeln(a); writeln(? a == false); writeln(true);");
+
+    const std::string ir = compiler->get_llvm_ir_as_string();
+    const std::string true_literal = "c\"true\"";
+
+    EXPECT_FALSE(llvm::verifyModule(compiler->get_module()));
+    EXPECT_NE(ir.find(true_literal), std::string::npos);
+    EXPECT_EQ(ir.find(true_literal), ir.rfind(true_literal));
+}
+
+TEST(LLVMCompilerTest, StringPoolDeduplicatesLiterals)
+{
+    std::unique_ptr<LLVMCompiler> compiler = compile("use io; mut s = \"hi\"; mut t = \"hi\"; writeln(s); writeln(t); writeln(\"%s\n\");");
+
+    auto count_globals = [&compiler](llvm::StringRef bytes)
+    {
+        size_t count = 0;
+
+        for (const llvm::GlobalVariable& global : compiler->get_module().globals())
+        {
+            const auto* data = llvm::dyn_cast_or_null<llvm::ConstantDataArray>(global.getInitializer());
+            count += data && data->isString() && data->getAsString() == bytes;
+        }
+
+        return count;
+    };
+
+    EXPECT_EQ(count_globals("hi"), 1u);
+    EXPECT_EQ(count_globals("\n"), 1u);
+    EXPECT_EQ(run_and_capture(*compiler).output, "hi\nhi\n%s\n\n");
+}
+
+TEST(LLVMJitRunnerTest, BufferedOutputRuntime)
+{
+    std::unique_ptr<LLVMCompiler> compiler = compile("use io; writeln(\"dust\"); writeln(0 - 9223372036854775807 - 1); writeln(0); "
+                                                     "writeln(7 / 2.0); writeln(? 1 > 2); exit(3);");
+
+    EXPECT_EQ(compiler->get_llvm_ir_as_string().find("@printf("), std::string::npos);
+
+    RunResult result = run_and_capture(*compiler);
+
+    EXPECT_EQ(result.exit_code, 3);
+    EXPECT_EQ(result.output, "dust\n-9223372036854775808\n0\n3.500000\nfalse\n");
+}
+
+TEST(LLVMCompilerTest, CoalescesConstantOutput)
+{
+    std::unique_ptr<LLVMCompiler> compiler = compile("use io; const n = 40 + 2; writeln(\"n is\"); writeln(n); writeln(n / 4.0); writeln(? n > 1);");
+
+    const std::string ir = compiler->get_llvm_ir_as_string();
+
+    EXPECT_NE(ir.find("c\"n is\\0A42\\0A10.500000\\0Atrue\\0A\""), std::string::npos);
+    EXPECT_EQ(ir.find("call void @dust_write_i64"), std::string::npos);
+    EXPECT_EQ(ir.find("call void @dust_write_f64"), std::string::npos);
+}
+
+TEST(LLVMJitRunnerTest, ReassignmentUsesSlots)
+{
+    RunResult result = run_and_capture("use io; mut s = \"a\"; writeln(s); s = \"bc\"; writeln(s); writeln(? s == \"bc\"); "
+                                       "mut n = 2; n = n * 21; writeln(n); n = 1.5; writeln(n); exit(n * 2);");
+
+    EXPECT_EQ(result.exit_code, 3);
+    EXPECT_EQ(result.output, "a\nbc\ntrue\n42\n1.500000\n");
+}
+
+TEST(LLVMJitRunnerTest, StringEqualityAtRuntime)
+{
+    std::unique_ptr<LLVMCompiler> compiler = compile("use io; mut a = \"abc\"; mut b = \"abd\"; writeln(? a == b); b = \"abc\"; writeln(? a == b); "
+                                                     "writeln(? a != \"ab\"); writeln(? b == \"\");");
+
+    EXPECT_NE(compiler->get_llvm_ir_as_string().find("@memcmp"), std::string::npos);
+    EXPECT_EQ(run_and_capture(*compiler).output, "false\ntrue\ntrue\nfalse\n");
+}
+
+TEST(LLVMJitRunnerTest, LoopsRunToCompletion)
+{
+    RunResult result = run_and_capture("use io; mut sum = 0; for (mut i = 1; ? i < 101; i = i + 1) { sum = sum + i; } "
+                                       "mut n = 3; while (? n > 0) { writeln(\"tick\"); writeln(n); n = n - 1; } exit(sum);",
+                                       llvm::OptimizationLevel::O2);
+
+    EXPECT_EQ(result.exit_code, 5050);
+    EXPECT_EQ(result.output, "tick\n3\ntick\n2\ntick\n1\n");
+}
+
+TEST(LLVMJitRunnerTest, FunctionsAreInternalFastcc)
+{
+    std::unique_ptr<LLVMCompiler> compiler = compile("use io; const scale = 2.5; fn add(a: int, b: int): int { return a + b; } "
+                                                     "fn fact(n: int): int { mut r = 1; while (? n > 1) { r = r * n; n = n - 1; } return r; } "
+                                                     "fn scaled(x: float): float { return x * scale; } fn greet(name: str) { writeln(name); } "
+                                                     "greet(\"dust\"); writeln(fact(5)); writeln(scaled(2)); exit(add(40, 2));");
+
+    std::string ir = compiler->get_llvm_ir_as_string();
+    EXPECT_NE(ir.find("define internal fastcc i64 @fn.add(i64 %a, i64 %b)"), std::string::npos);
+    EXPECT_NE(ir.find("call fastcc i64 @fn.fact(i64 5)"), std::string::npos);
+
+    RunResult result = run_and_capture(*compiler, llvm::OptimizationLevel::O2);
+
+    EXPECT_EQ(result.exit_code, 42);
+    EXPECT_EQ(result.output, "dust\n120\n5.000000\n");
+}
+
+TEST(LLVMCompilerTest, ValueFunctionsMustReturn)
+{
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+
+    EXPECT_EXIT(compile("fn noret(): int { mut a = 1; }"), testing::ExitedWithCode(EXIT_FAILURE),
+                "Syntax error. Function 'noret' can reach its end without returning a value.");
+    EXPECT_EXIT(compile("fn first(n: int): int { while (? n > 0) { return n; } }"), testing::ExitedWithCode(EXIT_FAILURE),
+                "Syntax error. Function 'first' can reach its end without returning a value.");
+
+    compile("fn one(): int { mut a = 1; return a; } fn nothing() { mut b = 2; }")->verify_module();
+}
+
+TEST(LLVMJitRunnerTest, ArraysComputeElementWise)
+{
+    std::unique_ptr<LLVMCompiler> compiler = compile("use io; const w = [0.5, 0.25, 2.0, 1.0]; mut a = [1, 2, 3, 4]; mut b = a * w + 1; "
+                                                     "mut x = [0.0; 1000]; for (mut i = 0; ? i < 1000; i = i + 1) { x[i] = i; } "
+                                                     "mut y = x * x - x; mut s = 0.0; for (mut i = 0; ? i < 1000; i = i + 1) { s = s + y[i]; } "
+                                                     "writeln(b[2]); writeln(s); exit(a[3]);");
+
+    std::string ir = compiler->get_llvm_ir_as_string();
+    EXPECT_NE(ir.find("fmul <4 x double>"), std::string::npos);
+    EXPECT_NE(ir.find("@x = internal global [1000 x double] zeroinitializer, align 64"), std::string::npos);
+
+    RunResult result = run_and_capture(*compiler, llvm::OptimizationLevel::O2);
+
+    EXPECT_EQ(result.exit_code, 4);
+    EXPECT_EQ(result.output, "7.000000\n332334000.000000\n");
+}
+
+TEST(LLVMJitRunnerTest, IndexErrorKeepsEarlierOutput)
+{
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+
+    // The error goes to stderr, so stdout is sent there too to see both.
+    EXPECT_EXIT({
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        LLVMJitRunner(compile("use io; mut a = [1, 2, 3]; mut i = 5; writeln(\"before\"); writeln(a[i]);")->release_module()).run();
+    }, testing::ExitedWithCode(EXIT_FAILURE), "before\nError: Array index out of bounds.");
+}
+
+TEST(LLVMJitRunnerTest, DivisionErrorsAreChecked)
+{
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+
+    std::unique_ptr<LLVMCompiler> compiler = compile("use io; mut a = 7; mut b = [4, 9]; writeln(a / 2); mut c = b / 3; writeln(c[1]); exit(a / (0 - 7));");
+    EXPECT_EQ(compiler->get_llvm_ir_as_string().find("dust_division_error"), std::string::npos);
+
+    EXPECT_EXIT({
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        LLVMJitRunner(compile("use io; writeln(\"a\"); mut z = 0; writeln(10 / z);")->release_module()).run();
+    }, testing::ExitedWithCode(EXIT_FAILURE), "a\nError: Integer division by zero or overflow.");
+
+    EXPECT_EXIT({
+        LLVMJitRunner(compile("mut m = 0 - 9223372036854775807 - 1; mut n = 0 - 1; exit(m / n);")->release_module(),
+                      llvm::OptimizationLevel::O2).run();
+    }, testing::ExitedWithCode(EXIT_FAILURE), "Error: Integer division by zero or overflow.");
+}
+
+TEST(LLVMCompilerTest, FastMathFlagsAndHostCpu)
+{
+    std::unique_ptr<LLVMCompiler> compiler = compile("mut f = 0.5; mut i = 0; while (? i < 100) { f = f * 1.5 + i; i = i + 1; } exit(f);", true);
+    compiler->verify_module();
+
+    std::string ir = compiler->get_llvm_ir_as_string();
+    EXPECT_NE(ir.find("fmul fast double"), std::string::npos);
+    EXPECT_NE(ir.find("\"unsafe-fp-math\"=\"true\""), std::string::npos);
+
+    TargetCpu cpu = resolve_target_cpu("native");
+    EXPECT_EQ(cpu.name, llvm::sys::getHostCPUName().str());
+
+    std::unique_ptr<llvm::TargetMachine> target_machine = create_target_machine(llvm::OptimizationLevel::O2, cpu, true);
+    EXPECT_EQ(target_machine->getTargetCPU(), cpu.name);
+    EXPECT_TRUE(target_machine->Options.UnsafeFPMath);
+
+    EXPECT_THROW(create_target_machine(llvm::OptimizationLevel::O2, resolve_target_cpu("no-such-cpu")), std::runtime_error);
+}
+
+TEST(ProgramBuilderTest, LinksModulesCompiledInParallel)
+{
+    std::filesystem::path directory = std::filesystem::path(testing::TempDir()) / "dust_modules";
+    std::filesystem::create_directories(directory);
+
+    std::ofstream(directory / "main.dust") << "use io; use shapes; use numbers; writeln(\"area\"); writeln(area(3)); exit(twice(21));";
+    std::ofstream(directory / "shapes.dust") << "use io; use numbers; const pi = 3.0; fn area(r: int): float { return pi * square(r); }";
+    std::ofstream(directory / "numbers.dust") << "fn twice(x: int): int { return x + x; } fn square(x: int): int { return x * x; }";
+
+    ProgramBuilder builder(llvm::OptimizationLevel::O2, {}, false);
+    std::unique_ptr<LLVMCompiler> compiler = builder.build((directory / "main.dust").string());
+    compiler->verify_module();
+
+    std::string ir = compiler->get_llvm_ir_as_string();
+    EXPECT_NE(ir.find("define fastcc i64 @numbers.twice("), std::string::npos);
+
+    std::unique_ptr<llvm::TargetMachine> target_machine = create_target_machine(llvm::OptimizationLevel::O2);
+    compiler->optimize(llvm::OptimizationLevel::O2, *target_machine);
+
+    RunResult result = run_and_capture(*compiler, llvm::OptimizationLevel::O2);
+
+    EXPECT_EQ(result.exit_code, 42);
+    EXPECT_EQ(result.output, "area\n27.000000\n");
+
+    std::filesystem::remove_all(directory);
+}
+
+TEST(BuildCacheTest, RestoresUnchangedBuildsAndEvictsLeastRecentlyUsed)
+{
+    std::filesystem::path directory = std::filesystem::path(testing::TempDir()) / "dust_cache";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "program");
+
+    std::filesystem::path main_file = directory / "program" / "main.dust";
+    std::filesystem::path module_file = directory / "program" / "numbers.dust";
+    std::filesystem::path output_file = directory / "program" / "out";
+    std::ofstream(module_file) << "fn twice(x: int): int { return x + x; }";
+
+    std::unique_ptr<llvm::TargetMachine> target_machine = create_target_machine(llvm::OptimizationLevel::O2);
+    CommandLineOptions options;
+    options.optimization_level = llvm::OptimizationLevel::O2;
+
+    std::string key = BuildCache::make_key("use numbers; exit(twice(21));", options, *target_machine);
+    EXPECT_EQ(key, BuildCache::make_key("use numbers; exit(twice(21));", options, *target_machine));
+
+    options.fast_math = true;
+    EXPECT_NE(key, BuildCache::make_key("use numbers; exit(twice(21));", options, *target_machine));
+    EXPECT_NE(key, BuildCache::make_key("use numbers; exit(twice(20));", CommandLineOptions{}, *target_machine));
+
+    BuildCache cache(directory / "cache", 1024);
+    EXPECT_FALSE(cache.restore(key, main_file.string(), output_file.string()));
+
+    std::ofstream(output_file) << std::string(600, 'a');
+    cache.store(key, main_file.string(), { module_file.string() }, output_file.string());
+    std::filesystem::remove(output_file);
+
+    ASSERT_TRUE(cache.restore(key, main_file.string(), output_file.string()));
+    EXPECT_EQ(std::filesystem::file_size(output_file), 600u);
+
+    std::ofstream(module_file) << "fn twice(x: int): int { return x * 2; }";
+    EXPECT_FALSE(cache.restore(key, main_file.string(), output_file.string()));
+
+    cache.store(key, main_file.string(), { module_file.string() }, output_file.string());
+    ASSERT_TRUE(cache.restore(key, main_file.string(), output_file.string()));
+
+    // Another build's half-assembled entry, older than everything else.
+    std::filesystem::path staging = directory / "cache" / "pending.tmp1";
+    std::filesystem::create_directories(staging);
+    std::ofstream(staging / "executable") << std::string(600, 'c');
+    std::filesystem::last_write_time(staging, std::filesystem::file_time_type::clock::now() - std::chrono::hours(2));
+
+    // A second entry pushes the cache over its limit, so the least recently
+    // used one goes.
+    std::ofstream(output_file) << std::string(600, 'b');
+    std::filesystem::last_write_time(directory / "cache" / key, std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+    cache.store("other", main_file.string(), {}, output_file.string());
+
+    EXPECT_FALSE(cache.restore(key, main_file.string(), output_file.string()));
+    EXPECT_TRUE(cache.restore("other", main_file.string(), output_file.string()));
+    EXPECT_TRUE(std::filesystem::exists(staging / "executable"));
+
+    std::filesystem::remove_all(directory);
+}
+
 int main(int argc, char** argv)
 {
     ::testing::InitGoogleTest(&argc, argv);
 
     return RUN_ALL_TESTS();
-}
\ No newline at end of file
+}